@@ -0,0 +1,67 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace checkers
+{
+  // Bump allocator for objects that all die together, like the nodes
+  // of a search tree. Memory is carved out of large chunks in order,
+  // and reset() frees everything at once by rewinding to the first
+  // chunk. Chunks are kept for reuse. Destructors are never run, so
+  // only trivially destructible types belong here. Not thread safe;
+  // use one arena per thread.
+  class Arena
+  {
+  public:
+    Arena(size_t chunk_size = 1 << 20);
+    void* allocate(size_t size, size_t align);
+    void reset();
+    size_t bytes_used() const; // Allocated since the last reset
+    size_t bytes_reserved() const; // Held in chunks
+    size_t num_objects() const; // Created by make since the last reset
+
+    // Uninitialized storage for n objects of type T.
+    template <class T>
+    T* allocate_array(size_t n)
+    {
+      return static_cast<T*>(this->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // n default-constructed objects of type T.
+    template <class T>
+    T* make_array(size_t n)
+    {
+      this->objects += n;
+      T *array = this->allocate_array<T>(n);
+      for (size_t i = 0; i < n; ++i) {
+	new (&array[i]) T();
+      }
+      return array;
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args)
+    {
+      ++this->objects;
+      return new (this->allocate(sizeof(T), alignof(T)))
+	T(std::forward<Args>(args)...);
+    }
+  private:
+    struct Chunk
+    {
+      std::unique_ptr<char[]> data;
+      size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t current; // Chunk being filled
+    size_t offset; // First free byte of the current chunk
+    size_t chunk_size, used, reserved, objects;
+  };
+}
+
+#endif
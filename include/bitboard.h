@@ -0,0 +1,89 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <cstdint>
+
+namespace checkers
+{
+  // Only the 32 dark squares of the board are playable. Square (i, j)
+  // is stored at bit 4*i + j/2, so each row occupies a nibble. On
+  // even rows the playable columns are 1, 3, 5, 7 and on odd rows
+  // they are 0, 2, 4, 6.
+  typedef uint32_t Bitboard;
+
+  const Bitboard ALL_SQUARES = 0xFFFFFFFF;
+  const Bitboard EVEN_ROWS = 0x0F0F0F0F;
+  const Bitboard ODD_ROWS = 0xF0F0F0F0;
+  const Bitboard ROW_0 = 0x0000000F;
+  const Bitboard ROW_7 = 0xF0000000;
+  // First and last playable square of each row.
+  const Bitboard FILE_0 = 0x11111111;
+  const Bitboard FILE_3 = 0x88888888;
+
+  // Diagonal directions. "Up" is towards row 7, which is forward
+  // for P1. The opposite of direction d is 3 - d.
+  enum Direction { up_west, up_east, down_west, down_east };
+
+  constexpr Direction opposite(Direction d)
+  {
+    return static_cast<Direction>(3 - d);
+  }
+
+  inline Bitboard square_bit(int s)
+  {
+    return Bitboard(1) << s;
+  }
+
+  inline int square_index(int i, int j)
+  {
+    return 4 * i + j / 2;
+  }
+
+  inline int square_row(int s)
+  {
+    return s >> 2;
+  }
+
+  inline int square_col(int s)
+  {
+    return 2 * (s & 3) + ((s >> 2) & 1 ? 0 : 1);
+  }
+
+  inline int popcount(Bitboard b)
+  {
+    return __builtin_popcount(b);
+  }
+
+  // Index of the lowest set bit. b must be nonzero.
+  inline int lsb(Bitboard b)
+  {
+    return __builtin_ctz(b);
+  }
+
+  // Move every square of b one step in direction d. Squares that
+  // would leave the board are dropped.
+  inline Bitboard shift(Bitboard b, Direction d)
+  {
+    switch (d) {
+    case up_west:
+      return ((b & EVEN_ROWS) << 4) | ((b & ODD_ROWS & ~FILE_0 & ~ROW_7) << 3);
+    case up_east:
+      return ((b & EVEN_ROWS & ~FILE_3) << 5) | ((b & ODD_ROWS & ~ROW_7) << 4);
+    case down_west:
+      return ((b & EVEN_ROWS & ~ROW_0) >> 4) | ((b & ODD_ROWS & ~FILE_0) >> 5);
+    case down_east:
+      return ((b & EVEN_ROWS & ~FILE_3 & ~ROW_0) >> 3) | ((b & ODD_ROWS) >> 4);
+    }
+    return 0;
+  }
+
+  // shift for a direction known at compile time, which leaves only
+  // the one case.
+  template <Direction D>
+  inline Bitboard shift(Bitboard b)
+  {
+    return shift(b, D);
+  }
+}
+
+#endif
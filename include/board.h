@@ -1,73 +1,151 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include <cstdint>
 #include <iostream>
 #include <vector>
+#include "bitboard.h"
+#include "rng.h"
 
 #define BOARD_SIZE 8
 
+// A piece jumps over the center of a 2x2 cell of its jump lattice each
+// time it captures, and the lattice only has 9 such centers.
+#define MAX_TAKE_LENGTH 9
+
+// Capacity of an ActionList. Far more actions than any reachable
+// position has; actions beyond it are dropped.
+#define MAX_ACTIONS 256
+
+// Piece values of Board::evaluate, in fixed point.
+#define MAN_VALUE 100
+#define KING_VALUE 150
+
 namespace checkers
 {
   typedef unsigned char byte;
   enum Player : byte;
+  class Tablebase;
   enum Square : byte { empty, P1_piece, P1_king, P2_piece, P2_king };
-  enum MoveKind : byte { move, take };
 
 
-  // A single move of a piece.
-  struct Move
+  // A player action: a piece leaves square from and lands on each
+  // square of path in turn, capturing the pieces on the squares in
+  // taken. A simple move has a single landing square and nothing
+  // taken. Squares are bitboard indices (see bitboard.h). Actions are
+  // plain 16-byte values, so they can be copied and stored freely.
+  struct Action
   {
-    Move(int i1, int j1, int i2, int j2, MoveKind kind, Player player)
-    : i1(i1), j1(j1), i2(i2), j2(j2), kind(kind), player(player) {}
-    void print() const;
-    int i1, j1, i2, j2;
-    MoveKind kind;
-    Player player;
+    byte from;
+    byte length; // Number of landing squares, 0 for nil.
+    byte path[MAX_TAKE_LENGTH];
+    Bitboard taken;
+    static Action nil() { return Action(); }
+    bool is_nil() const { return this->length == 0; }
+    bool is_take() const { return this->taken != 0; }
+    int to() const { return this->path[this->length - 1]; }
+    // Stable integer encoding: the origin, the length and the
+    // direction of every step. Equal actions have equal ids.
+    uint32_t id() const;
+    static Action from_id(uint32_t id);
+    bool operator==(const Action &other) const;
+    bool operator!=(const Action &other) const { return !(*this == other); }
   };
 
-  std::ostream& operator<<(std::ostream &os, const Move &m);
-  std::ostream& operator<<(std::ostream &os, const std::vector<Move> &ms);
+  std::ostream& operator<<(std::ostream &os, const Action &a);
 
 
-  // A player actions is sequence of piece moves. In most cases it's a
-  // singleton, but sometimes there are multiple jumps in a single
-  // action.
-  struct Action
+  // Fixed-capacity, caller-owned storage for actions so that
+  // generating them never touches the heap.
+  struct ActionList
   {
-    Action() {};
-    Action(const std::vector<Move> &moves) : moves(moves) {};
-    static Action nil() { return Action(); }
-    std::vector<Move> moves;
+    ActionList() : size(0) {}
+    const Action* begin() const { return this->actions; }
+    const Action* end() const { return this->actions + this->size; }
+    const Action& operator[](int i) const { return this->actions[i]; }
+    Action& operator[](int i) { return this->actions[i]; }
+    bool empty() const { return this->size == 0; }
+    int size;
+    Action actions[MAX_ACTIONS];
   };
 
-  std::ostream& operator<<(std::ostream &os, const Action &a);
+
+  // What Board::undo_action needs to take back an action besides the
+  // action itself: the parts of the board it doesn't determine.
+  struct Undo
+  {
+    uint64_t key;
+    Bitboard kings;
+    int16_t material[2];
+  };
+
+
+  // What a player can do, as told by Board::mobility without
+  // generating the actions.
+  enum Mobility { immobile, moves_only, must_take };
 
 
   // A board contains the board state and provides methods for
-  // computing legal moves and evaluating the current position.
+  // computing legal moves and evaluating the current position. The
+  // position is stored as bitboards (see bitboard.h) and moves are
+  // generated by shifting whole masks at once. The Zobrist hash of
+  // the position and the material of each player are kept up to date
+  // by apply_action, so hashing and evaluating are O(1).
   class Board
   {
   public:
     Board();
     Board(Square board[BOARD_SIZE][BOARD_SIZE]);
-    std::vector<Action>
-      legal_takes_for_piece(int i, int j, bool is_king, Player player) const;
-    std::vector<Move>
-      legal_moves_for_piece(int i, int j, bool is_king, Player player) const;
+    Board(Bitboard p1_pieces, Bitboard p2_pieces, Bitboard kings);
+    int legal_takes(Player player, ActionList &takes) const;
+    int legal_actions(Player player, ActionList &actions) const;
     std::vector<Action> legal_actions(Player player) const;
-    void apply_action(const Action &a);
+    bool random_action(Player player, Rng &rng, Action &action) const;
+    Mobility mobility(Player player) const;
+    Undo apply_action(const Action &a);
+    // Takes back a, which must be the last action applied, given what
+    // applying it returned.
+    void undo_action(const Action &a, const Undo &undo);
     void print() const;
-    double evaluate(Player p) const;
+    // Material balance in p's favor, where a man is worth MAN_VALUE.
+    int evaluate(Player p) const
+    {
+      return this->material[p] - this->material[!p];
+    }
+    uint64_t hash() const { return this->key; }
+    Square at(int i, int j) const;
+    Bitboard pieces_of(Player player) const { return this->pieces[player]; }
+    Bitboard king_squares() const { return this->kings; }
     bool operator==(const Board &other) const;
     bool operator<(const Board &other) const;
   private:
-    Square board[BOARD_SIZE][BOARD_SIZE];
+    Bitboard pieces[2]; // Indexed by Player
+    Bitboard kings; // Kings of both players
+    uint64_t key; // Zobrist hash of the pieces, see zobrist.h
+    int16_t material[2]; // Value of the pieces of each player
     void init();
-    std::vector<std::vector<std::pair<int, int>>>
-      legal_takes_for_piece_rec(int i, int j, bool is_king, Player player,
-				std::vector<std::pair<int, int>>
-				prev_taken) const;
+    void move_pieces(const Action &a);
+    uint64_t compute_key() const;
+    void compute_material();
+    Bitboard empty_squares() const;
+    // Move generation for a player known at compile time. The
+    // public functions taking a Player dispatch to these once.
+    template <Player P> Bitboard jumpers() const;
+    template <Player P> int takes_of(Bitboard jumpers,
+				     ActionList &takes) const;
+    template <Player P, bool King>
+    void legal_takes_for_piece_rec(int s, Action &chain,
+				   ActionList &takes) const;
+    template <Player P, bool King, Direction D>
+    bool extend_take(int s, Bitboard enemy, Bitboard empty, Action &chain,
+		     ActionList &takes) const;
+    template <Player P> int legal_actions(ActionList &actions) const;
+    template <Player P> bool random_action(Rng &rng, Action &action) const;
+    template <Player P> Mobility mobility() const;
     friend std::ostream& operator<<(std::ostream& out, const Board& b);
+    template <Player P>
+    friend bool playout_ply(Board &board, Rng &rng,
+			    const Tablebase *tablebase, double &result);
   };
 
   std::ostream& operator<<(std::ostream &os, const Board &m);
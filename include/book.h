@@ -0,0 +1,57 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+namespace checkers
+{
+  // What is known about a position: the MCTS statistics of its node
+  // and the id of the most visited action from it (0 if none, see
+  // Action::id). Keyed by State::hash.
+  struct BookEntry
+  {
+    uint64_t key;
+    double total_reward;
+    uint32_t visit_count;
+    uint32_t best_action;
+  };
+
+  // A persistent position store kept in a file: a small header and
+  // the entries sorted by key. The file is mapped read-only, so
+  // opening it costs nothing up front and processes on the same host
+  // share its pages. Lookups are binary searches and are safe from
+  // any number of threads.
+  class Book
+  {
+  public:
+    Book();
+    bool open(const std::string &path); // false if missing or invalid
+    void close();
+    bool is_open() const;
+    const BookEntry* find(uint64_t key) const; // nullptr if absent
+    const BookEntry* begin() const;
+    const BookEntry* end() const;
+    size_t size() const;
+  private:
+    MappedFile file;
+    const BookEntry *entries;
+    size_t count;
+  };
+
+  // Which of two entries of the same position to keep. Searches start
+  // from the statistics already in the book, so the entry with more
+  // visits already accounts for the other one.
+  const BookEntry& merge_entries(const BookEntry &a, const BookEntry &b);
+
+  // Writes entries as a book file, sorting them and merging those of
+  // the same position. The file is written next to path and renamed
+  // over it, so processes that have the old book mapped keep reading
+  // it unchanged.
+  bool write_book(const std::string &path, std::vector<BookEntry> entries);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace checkers
+{
+  // A whole file mapped read-only into memory. Pages are shared with
+  // every other process mapping the same file, and are only read from
+  // disk when touched.
+  class MappedFile
+  {
+  public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    bool open(const std::string &path); // false if it can't be mapped
+    void close();
+    bool is_open() const;
+    const void* data() const;
+    size_t size() const;
+  private:
+    void *addr;
+    size_t length;
+  };
+}
+
+#endif
@@ -1,15 +1,81 @@
 #ifndef MCTS_H
 #define MCTS_H
 
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "book.h"
+#include "stats.h"
+#include "store.h"
+#include "tablebase.h"
 #include "tree.h"
 
 namespace checkers
 {
   namespace MCTS
   {
+    // How UCTSearch uses several threads. Tree parallelism shares a
+    // single tree between all threads; root parallelism runs an
+    // independent search per thread, which avoids contention, and
+    // merges their root statistics to pick the move.
+    enum Parallelism { tree_parallel, root_parallel };
+
+    // What UCTSearch keeps from one search to the next: the
+    // statistics store and the tree of the last search, part of which
+    // the next one reuses. Games played at the same time each need
+    // their own; otherwise searches share a default one.
+    struct Context
+    {
+      Context() : saved_root(nullptr) {}
+      Store store;
+      // One per thread. The tree of the last search stays in arenas
+      // until the next one has copied the part it can reuse into
+      // spare_arenas; then the two are swapped.
+      std::vector<Arena> arenas, spare_arenas;
+      Node *saved_root;
+      State saved_state;
+    };
+
+    struct Options
+    {
+      Options() : num_threads(1), parallelism(tree_parallel),
+		  store_bytes(size_t(1) << 28), store_policy(keep_recent),
+		  book(nullptr), tablebase(nullptr), solver(true),
+		  context(nullptr) {}
+      int num_threads; // 0 means one per core
+      Parallelism parallelism;
+      // Memory cap and replacement policy of the statistics kept
+      // between searches (see store.h).
+      size_t store_bytes;
+      Replacement store_policy;
+      // Statistics of positions missing from the store are read from
+      // here if not null.
+      const Book *book;
+      // Playouts stop at positions in here if not null.
+      const Tablebase *tablebase;
+      // MCTS-Solver: positions that are won or lost, at the end of
+      // the game or in tablebase, are proven and the proofs are
+      // backed up the tree. Proven nodes get no more playouts, moves
+      // into lost positions are avoided and the search stops early
+      // once the root is proven.
+      bool solver;
+      Context *context; // The default one if null
+    };
+
     // Monte carlo tree search with UCB
     Action UCTSearch(const State &state, // root state
-		     int time_limit_ms); // time budget in milliseconds
+		     int time_limit_ms, // time budget in milliseconds
+		     const Options &options = Options(),
+		     SearchStats *stats = nullptr); // filled in if not null
+
+    // Plays a random game from state. Returns 1 if the player who
+    // moved into state wins, 0 if they lose and 0.5 for a draw.
+    double DefaultPolicy(const State &state);
+
+    // Writes the statistics gathered so far by all searches with the
+    // default context as a book file (see book.h). Returns false if
+    // the file can't be written.
+    bool save_store(const std::string &path);
   }
 }
 
@@ -2,19 +2,64 @@
 #define MINIMAX_H
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <vector>
+#include "book.h"
 #include "state.h"
+#include "stats.h"
+#include "tablebase.h"
+#include "ttable.h"
 
 namespace checkers
 {
-  // Iterative deepening alpha-beta minimax search.
-  std::pair<Action, double>
-    ABS_deepening(const State &state, int time_limit_ms);
+  // What the alpha-beta search keeps from one search to the next: the
+  // transposition table, shared by all of its threads, and the
+  // deadline of the search in progress. Games played at the same time
+  // each need their own; otherwise searches share a default one.
+  struct MinimaxContext
+  {
+    MinimaxContext() : deadline_active(false), stop(false) {}
+    TTable tt; // Scores are from the point of view of the player to move
+    bool deadline_active;
+    std::atomic<bool> stop;
+    std::chrono::steady_clock::time_point deadline;
+  };
 
-  // Depth-limited alpha-beta minimax search.
-  std::pair<Action, double>
+  struct MinimaxOptions
+  {
+    MinimaxOptions() : num_threads(1), book(nullptr), tablebase(nullptr),
+		       context(nullptr) {}
+    // Threads searching the same position and sharing the
+    // transposition table (Lazy SMP). 0 means one per core.
+    int num_threads;
+    const Book *book; // Helps order moves if not null
+    // Positions in here are scored without searching if not null.
+    const Tablebase *tablebase;
+    MinimaxContext *context; // The default one if null
+  };
+
+  // Iterative deepening alpha-beta minimax search. stats is filled in
+  // if not null.
+  std::pair<Action, int>
+    ABS_deepening(const State &state, int time_limit_ms,
+		  const MinimaxOptions &options = MinimaxOptions(),
+		  SearchStats *stats = nullptr);
+
+  // Depth-limited alpha-beta minimax search with the default context.
+  // Scores are from the point of view of the player to move, in the
+  // units of Board::evaluate.
+  std::pair<Action, int>
     ABS(const State &state, int d);
+
+  // Empties the transposition table of the default context, so that
+  // the next search starts from scratch.
+  void ABS_clear();
+
+  // Number of positions the calling thread has searched since it
+  // started.
+  unsigned long ABS_nodes();
 }
 
 #endif
@@ -0,0 +1,59 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+namespace checkers
+{
+  // splitmix64: advances x and returns the next output. Good for
+  // seeding and filling tables.
+  inline uint64_t splitmix64(uint64_t &x)
+  {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // xoshiro256** pseudorandom generator. A few cycles per number and
+  // 32 bytes of state, so every thread can keep its own.
+  class Rng
+  {
+  public:
+    explicit Rng(uint64_t seed)
+    {
+      for (int k = 0; k < 4; ++k) {
+	this->s[k] = splitmix64(seed);
+      }
+    }
+
+    uint64_t next()
+    {
+      uint64_t result = rotl(this->s[1] * 5, 7) * 9;
+      uint64_t t = this->s[1] << 17;
+      this->s[2] ^= this->s[0];
+      this->s[3] ^= this->s[1];
+      this->s[1] ^= this->s[2];
+      this->s[0] ^= this->s[3];
+      this->s[2] ^= t;
+      this->s[3] = rotl(this->s[3], 45);
+      return result;
+    }
+
+    // Uniform in [0, n) by multiplying instead of dividing. The bias
+    // is below n / 2^32, far too small to matter for playouts.
+    uint32_t below(uint32_t n)
+    {
+      return static_cast<uint32_t>(((this->next() >> 32) * n) >> 32);
+    }
+
+  private:
+    uint64_t s[4];
+    static uint64_t rotl(uint64_t x, int k)
+    {
+      return (x << k) | (x >> (64 - k));
+    }
+  };
+}
+
+#endif
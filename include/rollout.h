@@ -0,0 +1,19 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include "rng.h"
+#include "state.h"
+#include "tablebase.h"
+
+namespace checkers
+{
+  // Plays uniformly random actions from state until the player to
+  // move has none, or until the position is in tablebase if not
+  // null. Returns the result for the player to move in state: 1 for
+  // a win, 0 for a loss and 0.5 for a draw. Works on a copy of the
+  // board on the stack and never allocates.
+  double random_playout(const State &state, Rng &rng,
+			const Tablebase *tablebase = nullptr);
+}
+
+#endif
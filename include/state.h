@@ -1,6 +1,7 @@
 #ifndef STATE_H
 #define STATE_H
 
+#include <cstdint>
 #include <vector>
 #include "board.h"
 
@@ -27,8 +28,12 @@ namespace checkers
     Player next(); // Change current player
     void print() const;
     Player get_cur_player() const;
-    double evaluate(Player p) const;
-    void apply_action(const Action &a); // Also calls next()
+    int evaluate(Player p) const;
+    uint64_t hash() const; // Zobrist hash including the side to move
+    Undo apply_action(const Action &a); // Also calls next()
+    // Takes back a, which must be the last action applied, and gives
+    // the turn back.
+    void undo_action(const Action &a, const Undo &undo);
     Board board;
     bool operator==(const State &other) const;
     bool operator<(const State &other) const;
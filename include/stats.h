@@ -0,0 +1,48 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "board.h"
+
+namespace checkers
+{
+  // What a search did, filled in by UCTSearch or ABS_deepening when
+  // asked for. Times are in milliseconds. MCTS phase times are summed
+  // over threads, so with several threads they add up to more than
+  // the wall time. Fields that don't apply to a search stay zero.
+  struct SearchStats
+  {
+    SearchStats();
+    std::string algorithm; // "mcts" or "minimax"
+    Action action; // The action chosen
+    double score; // Minimax score for the player to move, see evaluate
+    std::vector<Action> pv; // Expected line of play from the root
+    double wall_ms;
+    double selection_ms, expansion_ms, playout_ms, backup_ms,
+      store_update_ms;
+    unsigned long iterations; // MCTS playouts
+    int threads;
+    int depth; // Deepest tree node or last completed minimax depth
+    int aborted_depth; // Minimax depth cut off by the deadline, or 0
+    unsigned long nodes; // Tree nodes allocated or positions searched
+    size_t tree_bytes;
+    size_t reused_nodes; // Taken over from the previous MCTS search
+    size_t peak_rss_bytes; // Of the whole process so far
+    double store_hit_rate; // Fraction of lookups during this search
+    size_t store_size, store_capacity, store_bytes;
+    double store_occupancy; // Fraction of the capacity in use
+    unsigned long store_evictions; // During this search
+    double tt_hit_rate;
+    double first_move_cutoff_rate;
+    void print() const; // Human-readable summary on cout
+    void write_json(std::ostream &os) const; // A single line of JSON
+  };
+
+  // Largest resident set size of this process so far, in bytes.
+  size_t peak_rss_bytes();
+}
+
+#endif
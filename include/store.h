@@ -0,0 +1,82 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace checkers
+{
+  // Statistics of a searched position, keyed by its Zobrist hash.
+  // A zero key marks an empty slot. best_action is the id of the most
+  // visited action (see Action::id), depth is the distance from the
+  // root of the search that stored it and generation the number of
+  // that search.
+  struct StoreEntry
+  {
+    uint64_t key;
+    double total_reward;
+    unsigned int visit_count;
+    uint32_t best_action;
+    unsigned short depth;
+    unsigned short generation;
+  };
+
+  // Which entry a full store evicts to make room.
+  enum Replacement
+  {
+    keep_shallow, // Evicts the entry deepest in its search tree
+    keep_visited, // Evicts the entry with the fewest visits
+    keep_recent // Evicts the entry from the oldest search, then the
+		// one with the fewest visits
+  };
+
+  struct StoreStats
+  {
+    unsigned long lookups, hits, evictions;
+    size_t size, capacity, bytes;
+    double hit_rate() const;
+    double occupancy() const;
+  };
+
+  // Flat open-addressing hash table from position hashes to MCTS
+  // statistics. An entry lives within PROBE_WINDOW slots of its home
+  // slot. The table doubles in size when it gets three quarters full,
+  // or half full and a window fills up, until doubling would exceed
+  // max_bytes. Otherwise a full window evicts one of its entries
+  // according to the replacement policy, so memory stays bounded.
+  class Store
+  {
+  public:
+    static const size_t PROBE_WINDOW = 8;
+    Store(size_t max_bytes = size_t(1) << 28,
+	  Replacement policy = keep_recent);
+    // nullptr if absent. Safe to call from several threads as long
+    // as nothing is inserted meanwhile.
+    const StoreEntry* find(uint64_t key) const;
+    StoreEntry& insert(uint64_t key, int depth); // Finds or adds an entry
+    void new_search(); // Ages the existing entries
+    void set_max_bytes(size_t max_bytes); // May drop entries
+    void set_policy(Replacement policy);
+    size_t size() const;
+    size_t capacity() const;
+    StoreStats stats() const;
+    void clear();
+    // Every slot, empty ones (key 0) included.
+    const StoreEntry* begin() const;
+    const StoreEntry* end() const;
+  private:
+    std::vector<StoreEntry> entries;
+    size_t count, max_bytes;
+    Replacement policy;
+    unsigned short generation;
+    mutable std::atomic<unsigned long> lookups, hits;
+    unsigned long evictions;
+    size_t max_capacity() const;
+    bool evicts_before(const StoreEntry &a, const StoreEntry &b) const;
+    void rehash(size_t capacity);
+  };
+}
+
+#endif
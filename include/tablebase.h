@@ -0,0 +1,64 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "state.h"
+
+// Most pieces a tablebase can cover. More than 6 takes far more
+// memory and time than is reasonable to generate.
+#define TABLEBASE_MAX_PIECES 6
+
+namespace checkers
+{
+  enum Outcome : signed char { loss = -1, draw = 0, win = 1 };
+
+  // The game-theoretic value of a position for the player to move,
+  // and for wins and losses how many plies the game lasts if the
+  // winner plays to the generator's line. Following strictly smaller
+  // distances always converts a win.
+  struct TBValue
+  {
+    Outcome outcome;
+    int distance;
+  };
+
+  // Perfect-play values of every position with at most max_pieces()
+  // pieces on the board, computed by retrograde analysis (see
+  // generate_tablebase). The file holds one table per material
+  // signature (men and kings of each side), each a byte per
+  // position, indexed by the squares of each kind of piece in the
+  // combinatorial number system and the player to move. Like a book
+  // the file is memory-mapped, and probes are safe from any number of
+  // threads.
+  class Tablebase
+  {
+  public:
+    Tablebase();
+    bool open(const std::string &path); // false if missing or invalid
+    void close();
+    bool is_open() const;
+    int max_pieces() const; // 0 if not open
+    // False if the position has too many pieces, or a side has
+    // none, and isn't in the tablebase.
+    bool probe(const Board &board, Player to_move, TBValue &value) const;
+    bool probe(const State &state, TBValue &value) const;
+  private:
+    MappedFile file;
+    int pieces;
+    // Table of each material signature, indexed by
+    // material_code (see tablebase.cc), nullptr if missing.
+    std::vector<const unsigned char*> tables;
+  };
+
+  // Solves every position with at most max_pieces pieces and writes
+  // the tablebase to path. Every position is visited once per pass
+  // and passes are repeated until none changes, each spread over
+  // num_threads threads (0 means one per core). Progress is reported
+  // on cout. Returns false if the file can't be written.
+  bool generate_tablebase(const std::string &path, int max_pieces,
+			  int num_threads = 0);
+}
+
+#endif
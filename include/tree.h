@@ -1,32 +1,62 @@
 #ifndef TREE_H
 #define TREE_H
 
-#include <map>
-#include <vector>
+#include <atomic>
+#include "arena.h"
 #include "state.h"
 
 namespace checkers
 {
-  // Game search tree nodes.
+  // Game search tree nodes. A node doesn't store its state, which is
+  // rebuilt by applying the actions on the path from the root, and
+  // doesn't generate its actions until it is first expanded. Then
+  // all of its children are created at once in one contiguous block,
+  // one per legal action, and visited for the first time in order.
+  //
+  // Several threads may search the same tree, so the statistics are
+  // atomic. Expansion is claimed by the first thread to get there,
+  // and a thread takes the next unvisited child by bumping
+  // next_child. Nodes live in an Arena and are freed all at once by
+  // resetting it.
+  //
+  // A node whose game-theoretic value is known is proven, as a win or
+  // a loss for the player who moved into it, like its rewards, along
+  // with how many plies the game lasts if the winner plays to the
+  // proof. A terminal node is proven when it's expanded; other proofs
+  // are set by the search, which writes proof_plies first.
   struct Node
   {
-    Node(Node *parent, const State &state, const Action &action);
-    ~Node();
-    int id;
+    enum Expansion : unsigned char { unexpanded, expanding, expanded };
+    enum Proof : signed char { proven_loss = -1, unproven, proven_win };
+    Node();
     Node *parent;
-    State state;
-    Action action;
-    double total_reward;
-    double avg_reward;
-    unsigned int visit_count;
-    std::vector<Action> unvisited_actions;
-    std::vector<Node*> children;
-  private:
-    void init(Node *parent, const State &state, const Action &action);
+    Node *children; // num_children nodes, valid once expanded
+    Action action; // Action leading here from the parent
+    std::atomic<double> total_reward;
+    std::atomic<unsigned int> visit_count;
+    std::atomic<unsigned int> next_child; // Next child to visit first
+    unsigned short num_children;
+    std::atomic<Expansion> expansion;
+    std::atomic<Proof> proof;
+    std::atomic<unsigned short> proof_plies;
+    bool expand(const State &state, Arena &arena);
+    double avg_reward() const;
+    bool is_expanded() const;
+    bool terminal() const; // Expanded and has no legal actions
+    bool fully_expanded() const; // Every child has been visited
+    unsigned int num_visited() const; // Children claimed so far
   };
 
   int tree_size(const Node *tree);
   int tree_depth(const Node *tree);
+
+  // Deep copy of tree into arena, with parent as the new root's parent.
+  Node* clone_tree(Arena &arena, Node *parent, const Node *tree);
+
+  // The node of tree, whose state is tree_state, at most max_depth
+  // levels down whose state is state, or nullptr.
+  Node* find_state(Node *tree, const State &tree_state, const State &state,
+		   int max_depth);
 }
 
 #endif
@@ -0,0 +1,58 @@
+#ifndef TTABLE_H
+#define TTABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace checkers
+{
+  // How a stored score relates to the true minimax value.
+  enum Bound : unsigned char { exact, lower, upper };
+
+  // A searched position. A zero key marks an empty slot and a zero
+  // move means no best move is known (see Action::id).
+  struct TTEntry
+  {
+    uint64_t key;
+    int score; // Between -32768 and 32767
+    uint32_t move;
+    signed char depth;
+    Bound bound;
+    unsigned char generation;
+  };
+
+  // Fixed-size, direct-mapped transposition table for the alpha-beta
+  // search. Entries from the current search are only overwritten by
+  // searches at least as deep; entries from earlier searches are
+  // always replaced.
+  //
+  // Any number of threads may probe and store at once without locks.
+  // Each slot is two words: the data packed into one, and the key
+  // xored with the data in the other. A slot that is half written by
+  // one thread while another reads it fails the key check and reads
+  // as a miss.
+  class TTable
+  {
+  public:
+    TTable(size_t capacity = 1 << 20); // Rounded up to a power of two
+    bool probe(uint64_t key, TTEntry &entry) const; // false on a miss
+    void store(uint64_t key, int depth, Bound bound, int score,
+	       uint32_t move);
+    void new_search(); // Ages the existing entries
+    void clear();
+    size_t capacity() const;
+  private:
+    struct Slot
+    {
+      std::atomic<uint64_t> check, data;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t size;
+    unsigned char generation; // Wraps around at 64
+    bool read(const Slot &slot, TTEntry &entry) const;
+  };
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define UTIL_H
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <vector>
 
@@ -14,23 +15,6 @@ namespace util
     return std::find(v.begin(), v.end(), x) != v.end();
   }
 
-  // a -> [[a]] -> [[a]]
-  // Given an element and a vector of vectors, return the vectors with
-  // x prepended to each.
-  template <class T>
-  std::vector<std::vector<T>>
-    prefix_vectors(const T &x, const std::vector<std::vector<T>> &l)
-  {
-    std::vector<std::vector<T>> result;
-    for (auto it = l.begin(); it != l.end(); ++it) {
-      std::vector<T> v;
-      v.push_back(x);
-      v.insert(v.end(), it->begin(), it->end());
-      result.push_back(v);
-    }
-    return result;
-  }
-
   // a -> [a]
   template <class T>
   std::vector<T> singleton(const T &x)
@@ -40,6 +24,16 @@ namespace util
     return v;
   }
 
+  // Atomically adds x to a. std::atomic only provides fetch_add for
+  // integral types.
+  template <class T>
+  void atomic_add(std::atomic<T> &a, T x)
+  {
+    T old = a.load(std::memory_order_relaxed);
+    while (!a.compare_exchange_weak(old, old + x,
+				    std::memory_order_relaxed)) {}
+  }
+
   // (a -> b) -> [a] -> [b]
   template <class S, class T>
   std::vector<T> fmap(const std::function<S(const T&)> &f,
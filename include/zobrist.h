@@ -0,0 +1,23 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+namespace checkers
+{
+  // Random keys for Zobrist hashing. A position's hash is the xor of
+  // the keys of its pieces, plus p2_to_move when it's P2's turn, so
+  // it can be updated incrementally as pieces move. The keys come
+  // from a fixed seed and are the same in every process.
+  struct ZobristKeys
+  {
+    ZobristKeys();
+    // Indexed by piece kind (2 * player + is_king) and square.
+    uint64_t piece[4][32];
+    uint64_t p2_to_move;
+  };
+
+  extern const ZobristKeys zobrist;
+}
+
+#endif
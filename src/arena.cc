@@ -0,0 +1,56 @@
+#include <algorithm>
+#include "arena.h"
+
+using namespace std;
+
+namespace checkers
+{
+  Arena::Arena(size_t chunk_size)
+    : current(0), offset(0), chunk_size(chunk_size), used(0), reserved(0),
+      objects(0) {}
+
+  void* Arena::allocate(size_t size, size_t align)
+  {
+    while (this->current < this->chunks.size()) {
+      Chunk &chunk = this->chunks[this->current];
+      size_t start = (this->offset + align - 1) & ~(align - 1);
+      if (start + size <= chunk.size) {
+	this->offset = start + size;
+	this->used += size;
+	return chunk.data.get() + start;
+      }
+      ++this->current;
+      this->offset = 0;
+    }
+    // Out of chunks, add one big enough for this allocation.
+    Chunk chunk;
+    chunk.size = max(size, this->chunk_size);
+    chunk.data.reset(new char[chunk.size]);
+    this->reserved += chunk.size;
+    this->chunks.push_back(move(chunk));
+    this->offset = size;
+    this->used += size;
+    return this->chunks.back().data.get();
+  }
+
+  void Arena::reset()
+  {
+    this->current = this->offset = 0;
+    this->used = this->objects = 0;
+  }
+
+  size_t Arena::bytes_used() const
+  {
+    return this->used;
+  }
+
+  size_t Arena::bytes_reserved() const
+  {
+    return this->reserved;
+  }
+
+  size_t Arena::num_objects() const
+  {
+    return this->objects;
+  }
+}
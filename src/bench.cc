@@ -0,0 +1,220 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <omp.h>
+#include <string>
+#include "board.h"
+#include "mcts.h"
+#include "minimax.h"
+#include "state.h"
+#include "stats.h"
+
+using namespace std;
+using namespace checkers;
+
+// Performance benchmarks. Every result is printed on its own line as
+// "name value", so runs of different builds can be compared with
+// diff or a script. Exits with status 1 if a perft count is wrong.
+//
+// Usage: bench [SECONDS]
+//
+// SECONDS is how long each timed benchmark runs, 2 by default.
+
+// Heap allocations made by the whole program.
+static atomic<unsigned long> allocations(0);
+
+void* operator new(size_t size)
+{
+  ++allocations;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+namespace
+{
+  // A position in the style of Board::print: x and o are men of P1
+  // and P2, X and O their kings, anything else an empty square.
+  State parse_state(const char *rows[BOARD_SIZE], Player to_move)
+  {
+    Square squares[BOARD_SIZE][BOARD_SIZE];
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+      for (int j = 0; j < BOARD_SIZE; ++j) {
+	switch (rows[i][j]) {
+	case 'x': squares[i][j] = P1_piece; break;
+	case 'X': squares[i][j] = P1_king; break;
+	case 'o': squares[i][j] = P2_piece; break;
+	case 'O': squares[i][j] = P2_king; break;
+	default: squares[i][j] = Square::empty; break;
+	}
+      }
+    }
+    return State(to_move, Board(squares));
+  }
+
+  // A middlegame with kings of both sides and multi-jumps.
+  const char *MIDDLEGAME[BOARD_SIZE] = {
+    "-x-x---x",
+    "x---X---",
+    "---x-o--",
+    "--o-----",
+    "-o---x--",
+    "--o-O---",
+    "-o---o-o",
+    "o---o---"
+  };
+
+  struct PerftCase
+  {
+    const char *name;
+    State state;
+    int depth;
+    unsigned long expected;
+  };
+
+  // Number of leaves of the game tree of the given depth.
+  unsigned long perft(const Board &board, Player player, int depth)
+  {
+    ActionList actions;
+    board.legal_actions(player, actions);
+    if (depth == 1) {
+      return actions.size;
+    }
+    unsigned long count = 0;
+    for (auto it = actions.begin(); it != actions.end(); ++it) {
+      Board b(board);
+      b.apply_action(*it);
+      count += perft(b, OTHER_PLAYER(player), depth - 1);
+    }
+    return count;
+  }
+
+  double seconds_since(chrono::steady_clock::time_point start)
+  {
+    return chrono::duration<double>(chrono::steady_clock::now() - start)
+      .count();
+  }
+
+  void report(const string &name, double value)
+  {
+    cout << name << " " << value << endl;
+  }
+
+  bool bench_perft(const PerftCase &c)
+  {
+    string prefix = string("perft.") + c.name + ".";
+    unsigned long allocs = allocations;
+    auto start = chrono::steady_clock::now();
+    unsigned long nodes = perft(c.state.board, c.state.get_cur_player(),
+				c.depth);
+    double seconds = seconds_since(start);
+    allocs = allocations - allocs;
+    report(prefix + "depth", c.depth);
+    report(prefix + "nodes", nodes);
+    report(prefix + "ok", nodes == c.expected);
+    report(prefix + "nodes_per_sec", nodes / seconds);
+    report(prefix + "allocs_per_node", double(allocs) / nodes);
+    if (nodes != c.expected) {
+      cerr << "perft " << c.name << ": expected " << c.expected <<
+	" nodes, got " << nodes << endl;
+    }
+    return nodes == c.expected;
+  }
+
+  void bench_playouts(const State &state, double seconds)
+  {
+    unsigned long count = 0, allocs = allocations;
+    double wins = 0.0;
+    auto start = chrono::steady_clock::now();
+    while (seconds_since(start) < seconds) {
+      wins += MCTS::DefaultPolicy(state);
+      ++count;
+    }
+    double elapsed = seconds_since(start);
+    allocs = allocations - allocs;
+    report("playout.count", count);
+    report("playout.per_sec", count / elapsed);
+    report("playout.allocs_per_playout", double(allocs) / count);
+    // A sanity check rather than a speed: should stay near 0.5.
+    report("playout.win_rate", wins / count);
+  }
+
+  // Searches deeper and deeper until an iteration takes longer than
+  // the budget, and reports the last one.
+  void bench_abs(const State &state, double seconds)
+  {
+    int depth = 0;
+    unsigned long nodes = 0, allocs = 0;
+    double elapsed = 0.0;
+    ABS_clear();
+    while (elapsed < seconds) {
+      ++depth;
+      unsigned long nodes_before = ABS_nodes(), allocs_before = allocations;
+      auto start = chrono::steady_clock::now();
+      ABS(state, depth);
+      elapsed = seconds_since(start);
+      nodes = ABS_nodes() - nodes_before;
+      allocs = allocations - allocs_before;
+    }
+    report("abs.depth", depth);
+    report("abs.nodes", nodes);
+    report("abs.nodes_per_sec", nodes / elapsed);
+    report("abs.allocs_per_node", double(allocs) / nodes);
+  }
+
+  // Depth reached and nodes searched by ABS_deepening in fixed time
+  // with one thread and with one per core, to measure the speedup of
+  // Lazy SMP.
+  void bench_abs_smp(const State &state, double seconds)
+  {
+    int max_threads = omp_get_max_threads();
+    for (int threads = 1; ; threads = max_threads) {
+      MinimaxOptions options;
+      options.num_threads = threads;
+      SearchStats stats;
+      ABS_clear();
+      ABS_deepening(state, static_cast<int>(1000 * seconds), options,
+		    &stats);
+      string prefix = "abs_smp.threads_" + to_string(threads) + ".";
+      report(prefix + "depth", stats.depth);
+      report(prefix + "nodes_per_sec", 1000.0 * stats.nodes / stats.wall_ms);
+      if (threads == max_threads) {
+	break;
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+  if (seconds <= 0.0) {
+    cerr << "usage: " << argv[0] << " [SECONDS]" << endl;
+    return 1;
+  }
+
+  cout << setprecision(12);
+  // The start position counts are the published ones for checkers.
+  PerftCase cases[] = {
+    {"start", State(), 10, 18391564},
+    {"middlegame", parse_state(MIDDLEGAME, P1), 11, 4267533}
+  };
+  bool ok = true;
+  for (auto &c : cases) {
+    ok = bench_perft(c) && ok;
+  }
+  bench_playouts(State(), seconds);
+  bench_abs(State(), seconds);
+  bench_abs_smp(State(), seconds);
+  return ok ? 0 : 1;
+}
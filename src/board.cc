@@ -1,17 +1,9 @@
-#include <cstring>
-#include <functional>
 #include <iostream>
-#include <iterator>
 #include "board.h"
 #include "state.h"
-#include "util.h"
+#include "zobrist.h"
 
 using namespace std;
-using namespace util;
-
-#define IN_BOUNDS(i) (i >= 0 && i < BOARD_SIZE)
-
-#define IS_EMPTY(square) (square == Square::empty)
 
 #define IS_KING(piece) (piece == P1_king || piece == P2_king)
 
@@ -20,6 +12,47 @@ using namespace util;
 
 namespace checkers
 {
+  namespace
+  {
+    // Men only move and jump forward, which is up for P1 and down
+    // for P2.
+    constexpr bool is_forward(Direction d, Player player)
+    {
+      return player == P1 ? (d == up_west || d == up_east) :
+	(d == down_west || d == down_east);
+    }
+
+    // Adds the pieces of P that can jump in direction D to jumpers,
+    // and sets movers to those that can make a simple move in it.
+    template <Player P, Direction D>
+    inline void scan(const Bitboard pieces[2], Bitboard kings,
+		     Bitboard empty, Bitboard &jumpers, Bitboard &movers)
+    {
+      constexpr Direction back = opposite(D);
+      Bitboard mine = pieces[P];
+      Bitboard can_move = is_forward(D, P) ? mine : mine & kings;
+      Bitboard before_empty = shift<back>(empty);
+      jumpers |= shift<back>(before_empty & pieces[OTHER_PLAYER(P)]) &
+	can_move;
+      movers = before_empty & can_move;
+    }
+
+    // Appends the simple move in direction D of each of movers.
+    template <Direction D>
+    inline void add_moves(Bitboard movers, ActionList &actions)
+    {
+      while (movers) {
+	int s = lsb(movers);
+	movers &= movers - 1;
+	Action &a = actions.actions[actions.size++];
+	a = Action::nil();
+	a.from = s;
+	a.length = 1;
+	a.path[0] = lsb(shift<D>(square_bit(s)));
+      }
+    }
+  }
+
   Board::Board()
   {
     this->init();
@@ -27,273 +60,349 @@ namespace checkers
 
   Board::Board(Square board[BOARD_SIZE][BOARD_SIZE])
   {
-    memcpy(this->board, board, BOARD_SIZE * BOARD_SIZE * sizeof(Square));
+    this->pieces[P1] = this->pieces[P2] = this->kings = 0;
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+      for (int j = (i + 1) % 2; j < BOARD_SIZE; j += 2) {
+	auto piece = board[i][j];
+	if (piece == Square::empty) {
+	  continue;
+	}
+	auto bit = square_bit(square_index(i, j));
+	this->pieces[PLAYER_OF(piece)] |= bit;
+	if (IS_KING(piece)) {
+	  this->kings |= bit;
+	}
+      }
+    }
+    this->key = this->compute_key();
+    this->compute_material();
+  }
+
+  Board::Board(Bitboard p1_pieces, Bitboard p2_pieces, Bitboard kings)
+  {
+    this->pieces[P1] = p1_pieces;
+    this->pieces[P2] = p2_pieces;
+    this->kings = kings;
+    this->key = this->compute_key();
+    this->compute_material();
   }
 
   void Board::init()
   {
-    bool j_offset = true;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-      for (int j = 0; j < BOARD_SIZE; ++j) {
-	this->board[i][j] = Square::empty;
+    // Three rows of men for each player.
+    this->pieces[P1] = 0x00000FFF;
+    this->pieces[P2] = 0xFFF00000;
+    this->kings = 0;
+    this->key = this->compute_key();
+    this->compute_material();
+  }
+
+  uint64_t Board::compute_key() const
+  {
+    uint64_t key = 0;
+    for (int p = P1; p <= P2; ++p) {
+      for (Bitboard b = this->pieces[p]; b; b &= b - 1) {
+	int s = lsb(b);
+	key ^= zobrist.piece[2 * p + bool(this->kings & square_bit(s))][s];
       }
     }
-    for (int i = 0; i < 3; ++i) {
-      int j = j_offset ? 1 : 0;
-      while (j < BOARD_SIZE) {
-	this->board[i][j] = P1_piece;
-	j += 2;
-      }
-      j_offset = !j_offset;
-    }
-    int i_offset = BOARD_SIZE - 3;
-    j_offset = false;
-    for (int i = 0; i < 3; ++i) {
-      int j = j_offset ? 1 : 0;
-      while (j < BOARD_SIZE) {
-	this->board[i + i_offset][j] = P2_piece;
-	j += 2;
-      }
-      j_offset = !j_offset;
+    return key;
+  }
+
+  void Board::compute_material()
+  {
+    for (int p = P1; p <= P2; ++p) {
+      this->material[p] =
+	MAN_VALUE * popcount(this->pieces[p] & ~this->kings) +
+	KING_VALUE * popcount(this->pieces[p] & this->kings);
     }
   }
 
-  double Board::evaluate(Player p) const
+  Bitboard Board::empty_squares() const
   {
-    double score = 0.0;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-      for (int j = 0; j < BOARD_SIZE; ++j) {
-	auto piece = this->board[i][j];
-	if (IS_PLAYER(piece, Player::P1)) {
-	  score += IS_KING(piece) ? 1.5 : 1.0;
-	}
-	else if (IS_PLAYER(piece, Player::P2)) {
-	  score -= IS_KING(piece) ? 1.5 : 1.0;
-	}
-      }
+    return ~(this->pieces[P1] | this->pieces[P2]);
+  }
+
+  Square Board::at(int i, int j) const
+  {
+    if ((i + j) % 2 == 0) {
+      return Square::empty;
+    }
+    auto bit = square_bit(square_index(i, j));
+    bool king = this->kings & bit;
+    if (this->pieces[P1] & bit) {
+      return king ? P1_king : P1_piece;
+    }
+    else if (this->pieces[P2] & bit) {
+      return king ? P2_king : P2_piece;
     }
-    return p == Player::P1 ? score : -score;
-    // return p == Player::P1 ? -score : score;
-    // return score;
+    return Square::empty;
   }
 
-  namespace
+  // Clears takes and fills it with every capture chain available to
+  // player. Returns the number of chains.
+  int Board::legal_takes(Player player, ActionList &takes) const
   {
-    vector<Move> convert_take_chain(const vector<pair<int, int>> &l,
-				    int init_i, int init_j, Player player)
-    {
-      auto prev_i = init_i, prev_j = init_j;
-      vector<Move> takes;
-      for (auto it = l.begin(); it != l.end(); ++it) {
-	auto i = it->first, j = it->second;
-	takes.push_back(Move(prev_i, prev_j, i, j, MoveKind::take, player));
-	prev_i = i;
-	prev_j = j;
-      }
-      return takes;
-    }
-  }
-
-  vector<Action>
-    Board::legal_takes_for_piece(int i, int j, bool is_king,
-				 Player player) const
-  {
-    auto take_coords =
-      this->legal_takes_for_piece_rec(i, j, is_king, player,
-    				      vector<pair<int, int>>());
-    vector<Action> takes;
-    for (auto it = take_coords.begin(); it != take_coords.end(); ++it) {
-      takes.push_back(convert_take_chain(*it, i, j, player));
-    }
-    return takes;
-  }
-
-  // prev_taken is passed by value because we modify it but don't want
-  // the changes to be seen by the parent call. It's like a reader
-  // context.
-  vector<vector<pair<int, int>>>
-    Board::legal_takes_for_piece_rec(int i, int j, bool is_king, Player player,
-				     vector<pair<int, int>> prev_taken) const
-  {
-    Player other = OTHER_PLAYER(player);
-    int forward = player == P1 ? 1 : -1;
-    vector<vector<pair<int, int>>> takes;
-    if (j > 1) {
-      // Take forward and west
-      pair<int, int> take = make_pair(i+2*forward, j-2);
-      if (IN_BOUNDS(i+2*forward) &&
-	  board[take.first][take.second] == Square::empty &&
-	  IS_PLAYER(board[i+forward][j-1], other) &&
-	  !elem(make_pair(i+forward, j-1), prev_taken)) {
-	auto taken = make_pair(i+forward, j-1);
-	prev_taken.push_back(taken);
-	auto rest_takes =
-	  this->legal_takes_for_piece_rec(i+2*forward, j-2, is_king,
-					  player, prev_taken);
-	if (rest_takes.empty()) {
-	  takes.push_back(singleton(take));
-	}
-	else {
-	  auto l = prefix_vectors(take, rest_takes);
-	  takes.insert(takes.end(), std::make_move_iterator(l.begin()),
-	  	       std::make_move_iterator(l.end()));
-	}
+    return player == P1 ? this->takes_of<P1>(this->jumpers<P1>(), takes) :
+      this->takes_of<P2>(this->jumpers<P2>(), takes);
+  }
+
+  // Clears actions and fills it with the legal actions of player.
+  // Returns the number of actions.
+  int Board::legal_actions(Player player, ActionList &actions) const
+  {
+    return player == P1 ? this->legal_actions<P1>(actions) :
+      this->legal_actions<P2>(actions);
+  }
+
+  // Sets action to one of the legal actions of player, chosen
+  // uniformly at random, and returns true, or returns false if there
+  // are none.
+  bool Board::random_action(Player player, Rng &rng, Action &action) const
+  {
+    return player == P1 ? this->random_action<P1>(rng, action) :
+      this->random_action<P2>(rng, action);
+  }
+
+  // Whether player is out of actions, can only move, or has to take,
+  // from the same shifts of the whole board that start move
+  // generation. Much cheaper than generating the actions, which is
+  // all a leaf of the search needs before it's evaluated.
+  Mobility Board::mobility(Player player) const
+  {
+    return player == P1 ? this->mobility<P1>() : this->mobility<P2>();
+  }
+
+  // The kernels below take the player, and where it helps the
+  // direction and whether the piece is a king, as template
+  // arguments, so the is_forward tests fold away and each side gets
+  // its own straight-line code.
+
+  // The pieces of P that can make at least one jump. Shifting the
+  // empty squares back over the enemy pieces finds every piece with
+  // a landing square two steps away in a given direction.
+  template <Player P>
+  Bitboard Board::jumpers() const
+  {
+    Bitboard empty = this->empty_squares(), result = 0, movers;
+    scan<P, up_west>(this->pieces, this->kings, empty, result, movers);
+    scan<P, up_east>(this->pieces, this->kings, empty, result, movers);
+    scan<P, down_west>(this->pieces, this->kings, empty, result, movers);
+    scan<P, down_east>(this->pieces, this->kings, empty, result, movers);
+    return result;
+  }
+
+  // legal_takes for a known set of jumpers.
+  template <Player P>
+  int Board::takes_of(Bitboard jumpers, ActionList &takes) const
+  {
+    takes.size = 0;
+    while (jumpers) {
+      int s = lsb(jumpers);
+      jumpers &= jumpers - 1;
+      Action chain = Action::nil();
+      chain.from = s;
+      if (this->kings & square_bit(s)) {
+	this->legal_takes_for_piece_rec<P, true>(s, chain, takes);
       }
-      // Take backward and west
-      take = make_pair(i-2*forward, j-2);
-      if (is_king && IN_BOUNDS(i-2*forward) &&
-	  IS_EMPTY(this->board[take.first][take.second]) &&
-	  IS_PLAYER(this->board[i-forward][j-1], other) &&
-	  !elem(make_pair(i-forward, j-1), prev_taken)) {
-	auto taken = make_pair(i-forward, j-1);
-	prev_taken.push_back(taken);
-	auto rest_takes =
-	  this->legal_takes_for_piece_rec(i-2*forward, j-2, is_king,
-					  player, prev_taken);
-	if (rest_takes.empty()) {
-	  takes.push_back(singleton(take));
-	}
-	else {
-	  auto l = prefix_vectors(take, rest_takes);
-	  takes.insert(takes.end(), std::make_move_iterator(l.begin()),
-	  	       std::make_move_iterator(l.end()));
-	}
+      else {
+	this->legal_takes_for_piece_rec<P, false>(s, chain, takes);
       }
     }
-    if (j < BOARD_SIZE-2) {
-      // Take forward and east
-      auto take = make_pair(i+2*forward, j+2);
-      if (IN_BOUNDS(i+2*forward) &&
-	  IS_EMPTY(this->board[take.first][take.second]) &&
-	  IS_PLAYER(this->board[i+forward][j+1], other) &&
-	  !elem(make_pair(i+forward, j+1), prev_taken)) {
-	auto taken = make_pair(i+forward, j+1);
-	prev_taken.push_back(taken);
-	auto rest_takes =
-	  this->legal_takes_for_piece_rec(i+2*forward, j+2, is_king,
-					  player, prev_taken);
-	if (rest_takes.empty()) {
-	  takes.push_back(singleton(take));
-	}
-	else {
-	  auto l = prefix_vectors(take, rest_takes);
-	  takes.insert(takes.end(), std::make_move_iterator(l.begin()),
-	  	       std::make_move_iterator(l.end()));
-	}
-      }
-      // Take backward and east
-      take = make_pair(i-2*forward, j+2);
-      if (is_king && IN_BOUNDS(i-2*forward) &&
-	  IS_EMPTY(this->board[take.first][take.second]) &&
-	  IS_PLAYER(this->board[i-forward][j+1], other) &&
-	  !elem(make_pair(i-forward, j+1), prev_taken)) {
-	auto taken = make_pair(i-forward, j+1);
-	prev_taken.push_back(taken);
-	auto rest_takes =
-	  this->legal_takes_for_piece_rec(i-2*forward, j+2, is_king,
-					  player, prev_taken);
-	if (rest_takes.empty()) {
-	  takes.push_back(singleton(take));
-	}
-	else {
-	  auto l = prefix_vectors(take, rest_takes);
-	  takes.insert(takes.end(), make_move_iterator(l.begin()),
-	  	       make_move_iterator(l.end()));
-	}
-      }
+    return takes.size;
+  }
+
+  // Extends chain, which currently ends on square s, by every jump
+  // available from s. Chains that can't be extended any further are
+  // complete and get copied into takes. chain is modified in place
+  // and restored before returning, so the search doesn't allocate.
+  template <Player P, bool King>
+  void Board::legal_takes_for_piece_rec(int s, Action &chain,
+					ActionList &takes) const
+  {
+    Bitboard enemy = this->pieces[OTHER_PLAYER(P)] & ~chain.taken;
+    Bitboard empty = this->empty_squares();
+    bool extended = false;
+    if (King || is_forward(up_west, P)) {
+      extended |= this->extend_take<P, King, up_west>(s, enemy, empty,
+						      chain, takes);
+    }
+    if (King || is_forward(up_east, P)) {
+      extended |= this->extend_take<P, King, up_east>(s, enemy, empty,
+						      chain, takes);
+    }
+    if (King || is_forward(down_west, P)) {
+      extended |= this->extend_take<P, King, down_west>(s, enemy, empty,
+							chain, takes);
+    }
+    if (King || is_forward(down_east, P)) {
+      extended |= this->extend_take<P, King, down_east>(s, enemy, empty,
+							chain, takes);
+    }
+    if (!extended && chain.length && takes.size < MAX_ACTIONS) {
+      takes.actions[takes.size++] = chain;
     }
-    return takes;
   }
 
-  vector<Move>
-  Board::legal_moves_for_piece(int i, int j, bool is_king, Player player) const
+  // One step of legal_takes_for_piece_rec: the jump from s in
+  // direction D, if there is one. Returns whether there was.
+  template <Player P, bool King, Direction D>
+  bool Board::extend_take(int s, Bitboard enemy, Bitboard empty,
+			  Action &chain, ActionList &takes) const
   {
-    auto forward = player == P1 ? 1 : -1;
-    vector<Move> moves;
-    if (j > 0) {
-      if (IN_BOUNDS(i+forward) && IS_EMPTY(this->board[i+forward][j-1])) {
-	// Move forward and west
-	moves.push_back(Move(i, j, i+forward, j-1, MoveKind::move, player));
-      }
-      if (is_king && IN_BOUNDS(i-forward) &&
-	  IS_EMPTY(this->board[i-forward][j-1])) {
-	// Move backward and west
-	moves.push_back(Move(i, j, i-forward, j-1, MoveKind::move, player));
-      }
+    Bitboard over = shift<D>(square_bit(s)) & enemy;
+    Bitboard land = shift<D>(over) & empty;
+    if (!land) {
+      return false;
     }
-    if (j < BOARD_SIZE-1) {
-      if (IN_BOUNDS(i+forward) && IS_EMPTY(this->board[i+forward][j+1])) {
-	// Move forward and east
-	moves.push_back(Move(i, j, i+forward, j+1, MoveKind::move, player));
-      }
-      if (is_king && IN_BOUNDS(i-forward) &&
-	  IS_EMPTY(this->board[i-forward][j+1])) {
-	// Move backward and east
-	moves.push_back(Move(i, j, i-forward, j+1, MoveKind::move, player));
-      }
+    chain.path[chain.length++] = lsb(land);
+    chain.taken |= over;
+    this->legal_takes_for_piece_rec<P, King>(lsb(land), chain, takes);
+    chain.taken &= ~over;
+    --chain.length;
+    return true;
+  }
+
+  template <Player P>
+  int Board::legal_actions(ActionList &actions) const
+  {
+    Bitboard empty = this->empty_squares(), jumpers = 0, movers[4];
+    scan<P, up_west>(this->pieces, this->kings, empty, jumpers, movers[0]);
+    scan<P, up_east>(this->pieces, this->kings, empty, jumpers, movers[1]);
+    scan<P, down_west>(this->pieces, this->kings, empty, jumpers, movers[2]);
+    scan<P, down_east>(this->pieces, this->kings, empty, jumpers, movers[3]);
+    // Takes are compulsory.
+    if (jumpers) {
+      return this->takes_of<P>(jumpers, actions);
+    }
+    actions.size = 0;
+    add_moves<up_west>(movers[0], actions);
+    add_moves<up_east>(movers[1], actions);
+    add_moves<down_west>(movers[2], actions);
+    add_moves<down_east>(movers[3], actions);
+    return actions.size;
+  }
+
+  // Jumpers and movers are found from the same shifts of the empty
+  // squares, and a simple move is built directly from its index, so
+  // the list is only generated when there are takes.
+  template <Player P>
+  bool Board::random_action(Rng &rng, Action &action) const
+  {
+    Bitboard empty = this->empty_squares(), jumpers = 0, movers[4];
+    scan<P, up_west>(this->pieces, this->kings, empty, jumpers, movers[0]);
+    scan<P, up_east>(this->pieces, this->kings, empty, jumpers, movers[1]);
+    scan<P, down_west>(this->pieces, this->kings, empty, jumpers, movers[2]);
+    scan<P, down_east>(this->pieces, this->kings, empty, jumpers, movers[3]);
+    if (jumpers) {
+      ActionList takes;
+      this->takes_of<P>(jumpers, takes);
+      action = takes[rng.below(takes.size)];
+      return true;
+    }
+    int total = popcount(movers[0]) + popcount(movers[1]) +
+      popcount(movers[2]) + popcount(movers[3]);
+    if (!total) {
+      return false;
+    }
+    // Same order as legal_actions: by direction, then by square.
+    int r = rng.below(total), k = 0;
+    while (r >= popcount(movers[k])) {
+      r -= popcount(movers[k++]);
+    }
+    Bitboard b = movers[k];
+    for (; r; --r) {
+      b &= b - 1;
+    }
+    int s = lsb(b);
+    action = Action::nil();
+    action.from = s;
+    action.length = 1;
+    action.path[0] = lsb(shift(square_bit(s), static_cast<Direction>(k)));
+    return true;
+  }
+
+  template <Player P>
+  Mobility Board::mobility() const
+  {
+    Bitboard empty = this->empty_squares(), jumpers = 0, movers[4];
+    scan<P, up_west>(this->pieces, this->kings, empty, jumpers, movers[0]);
+    scan<P, up_east>(this->pieces, this->kings, empty, jumpers, movers[1]);
+    scan<P, down_west>(this->pieces, this->kings, empty, jumpers, movers[2]);
+    scan<P, down_east>(this->pieces, this->kings, empty, jumpers, movers[3]);
+    if (jumpers) {
+      return must_take;
     }
-    return moves;
+    return movers[0] | movers[1] | movers[2] | movers[3] ? moves_only :
+      immobile;
   }
 
+  // random_playout uses the kernels directly.
+  template bool Board::random_action<P1>(Rng &rng, Action &action) const;
+  template bool Board::random_action<P2>(Rng &rng, Action &action) const;
+
   vector<Action> Board::legal_actions(Player player) const
   {
-    bool found_take = false;
-    vector<Action> all_actions;
-    // Look for takes
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-      for (int j = 0; j < BOARD_SIZE; ++j) {
-	auto piece = this->board[i][j];
-	if (!IS_EMPTY(piece) && PLAYER_OF(piece) == player) {
-	  auto takes =
-	    this->legal_takes_for_piece(i, j, IS_KING(piece), player);
-	  if (!takes.empty()) {
-	    found_take = true;
-	    all_actions.insert(all_actions.end(),
-			       make_move_iterator(takes.begin()),
-			       make_move_iterator(takes.end()));
-	  }
-	}
-      }
+    ActionList actions;
+    this->legal_actions(player, actions);
+    return vector<Action>(actions.begin(), actions.end());
+  }
+
+  Undo Board::apply_action(const Action &action)
+  {
+    Undo undo;
+    undo.key = this->key;
+    undo.kings = this->kings;
+    undo.material[P1] = this->material[P1];
+    undo.material[P2] = this->material[P2];
+    int s = action.from, t = action.to();
+    Player owner = this->pieces[P1] & square_bit(s) ? P1 : P2;
+    Player other = OTHER_PLAYER(owner);
+    bool king = this->kings & square_bit(s);
+    this->key ^= zobrist.piece[2 * owner + king][s];
+    for (Bitboard b = action.taken; b; b &= b - 1) {
+      int c = lsb(b);
+      bool taken_king = this->kings & square_bit(c);
+      this->key ^= zobrist.piece[2 * other + taken_king][c];
+      this->material[other] -= taken_king ? KING_VALUE : MAN_VALUE;
     }
-    // If no takes found, look for moves
-    if (!found_take) {
-      for (int i = 0; i < BOARD_SIZE; ++i) {
-	for (int j = 0; j < BOARD_SIZE; ++j) {
-	  auto piece = this->board[i][j];
-	  if (!IS_EMPTY(piece) && PLAYER_OF(piece) == player) {
-	    auto moves =
-	      this->legal_moves_for_piece(i, j, IS_KING(piece), player);
-	    vector<Action> actions;
-	    for (auto it = moves.begin(); it != moves.end(); ++it) {
-	      actions.push_back(Action(singleton(*it)));
-	    }
-	    all_actions.insert(all_actions.begin(),
-			       make_move_iterator(actions.begin()),
-			       make_move_iterator(actions.end()));
-	  }
-	}
-      }
+    this->move_pieces(action);
+    bool crowned = !king && (this->kings & square_bit(t));
+    this->key ^= zobrist.piece[2 * owner + (king || crowned)][t];
+    if (crowned) {
+      this->material[owner] += KING_VALUE - MAN_VALUE;
     }
-    return all_actions;
+    return undo;
   }
 
-  void Board::apply_action(const Action &action)
+  void Board::undo_action(const Action &action, const Undo &undo)
   {
-    for (auto it = action.moves.begin(); it != action.moves.end(); ++it) {
-      auto m = *it;
-      this->board[m.i2][m.j2] = this->board[m.i1][m.j1];
-      this->board[m.i1][m.j1] = Square::empty;
-      if (m.kind == MoveKind::take) {
-	auto i = (m.i1 + m.i2) / 2, j = (m.j1 + m.j2) / 2;
-	this->board[i][j] = Square::empty;
-      }
-      // Promote to king if able
-      if (m.player == Player::P1 && m.i2 == BOARD_SIZE-1) {
-	board[m.i2][m.j2] = Square::P1_king;
-      }
-      else if (m.player == Player::P2 && m.i2 == 0) {
-	board[m.i2][m.j2] = Square::P2_king;
-      }
+    Bitboard from = square_bit(action.from);
+    Bitboard to = square_bit(action.to());
+    Player owner = this->pieces[P1] & to ? P1 : P2;
+    this->pieces[owner] ^= from | to;
+    this->pieces[OTHER_PLAYER(owner)] |= action.taken;
+    this->kings = undo.kings;
+    this->key = undo.key;
+    this->material[P1] = undo.material[P1];
+    this->material[P2] = undo.material[P2];
+  }
+
+  // apply_action without updating the hash or the material.
+  void Board::move_pieces(const Action &action)
+  {
+    Bitboard from = square_bit(action.from);
+    Bitboard to = square_bit(action.to());
+    Player owner = this->pieces[P1] & from ? P1 : P2;
+    this->pieces[owner] ^= from | to;
+    if (this->kings & from) {
+      this->kings ^= from | to;
+    }
+    this->pieces[OTHER_PLAYER(owner)] &= ~action.taken;
+    this->kings &= ~action.taken;
+    // Promote to king if able
+    if (to & (owner == P1 ? ROW_7 : ROW_0)) {
+      this->kings |= to;
     }
   }
 
@@ -328,7 +437,7 @@ namespace checkers
   {
     for (int i = 0; i < BOARD_SIZE; ++i) {
       for (int j = 0; j < BOARD_SIZE; ++j) {
-	os << square_char(b.board[i][j]) << " ";
+	os << square_char(b.at(i, j)) << " ";
       }
       os << endl;
     }
@@ -340,56 +449,92 @@ namespace checkers
     cout << *this << endl;
   }
 
-  ostream& operator<<(ostream& os, const Move& m)
+  namespace
   {
-    os << '(' << m.i1 << ", " << m.j1 << ") (" << m.i2 <<
-      ", " << m.j2 << ") " << m.kind << ' ' << m.player;
-    return os;
+    // Direction of the step from square s to square t, which lie on
+    // a common diagonal.
+    inline Direction step_direction(int s, int t)
+    {
+      int d = square_row(t) < square_row(s) ? down_west : up_west;
+      return static_cast<Direction>(d + (square_col(t) > square_col(s)));
+    }
   }
 
-  ostream& operator<<(ostream &os, const vector<Move> &ms)
+  static_assert(sizeof(Action) == 16, "Action should stay packed");
+
+  uint32_t Action::id() const
   {
-    os << "[";
-    for (size_t i = 0; i < ms.size(); ++i) {
-      os << ms[i];
-      if (i < ms.size() - 1) {
-	os << ", ";
-      }
+    uint32_t id = this->from | (this->length << 5) |
+      (this->is_take() << 9);
+    int prev = this->from;
+    for (int k = 0; k < this->length; ++k) {
+      id |= step_direction(prev, this->path[k]) << (10 + 2 * k);
+      prev = this->path[k];
     }
-    os << "]";
-    return os;
+    return id;
   }
 
-  std::ostream& operator<<(std::ostream &os, const Action &a)
+  Action Action::from_id(uint32_t id)
   {
-    os << a.moves;
-    return os;
+    Action a = Action::nil();
+    a.from = id & 31;
+    a.length = (id >> 5) & 15;
+    bool take = (id >> 9) & 1;
+    Bitboard at = square_bit(a.from);
+    for (int k = 0; k < a.length; ++k) {
+      auto d = static_cast<Direction>((id >> (10 + 2 * k)) & 3);
+      at = shift(at, d);
+      if (take) {
+	a.taken |= at;
+	at = shift(at, d);
+      }
+      a.path[k] = lsb(at);
+    }
+    return a;
   }
 
-  bool Board::operator==(const Board &other) const
+  bool Action::operator==(const Action &other) const
   {
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-      for (int j = 0; j < BOARD_SIZE; ++j) {
-	if (this->board[i][j] != other.board[i][j]) {
-	  return false;
-	}
+    if (this->from != other.from || this->length != other.length ||
+	this->taken != other.taken) {
+      return false;
+    }
+    for (int k = 0; k < this->length; ++k) {
+      if (this->path[k] != other.path[k]) {
+	return false;
       }
     }
     return true;
   }
 
-  bool Board::operator<(const Board &other) const
+  ostream& operator<<(ostream &os, const Action &a)
   {
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-      for (int j = 0; j < BOARD_SIZE; ++j) {
-	if (this->board[i][j] < other.board[i][j]) {
-	  return true;
-	}
-	else if (this->board[i][j] > other.board[i][j]) {
-	  return false;
-	}
+    os << "[";
+    if (!a.is_nil()) {
+      os << '(' << square_row(a.from) << ", " << square_col(a.from) << ')';
+      for (int k = 0; k < a.length; ++k) {
+	os << (a.is_take() ? " x " : " - ") << '(' <<
+	  square_row(a.path[k]) << ", " << square_col(a.path[k]) << ')';
       }
     }
-    return false;
+    os << "]";
+    return os;
+  }
+
+  bool Board::operator==(const Board &other) const
+  {
+    return this->key == other.key && this->pieces[P1] == other.pieces[P1] &&
+      this->pieces[P2] == other.pieces[P2] && this->kings == other.kings;
+  }
+
+  bool Board::operator<(const Board &other) const
+  {
+    if (this->pieces[P1] != other.pieces[P1]) {
+      return this->pieces[P1] < other.pieces[P1];
+    }
+    if (this->pieces[P2] != other.pieces[P2]) {
+      return this->pieces[P2] < other.pieces[P2];
+    }
+    return this->kings < other.kings;
   }
 }
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "book.h"
+
+using namespace std;
+
+namespace checkers
+{
+  namespace
+  {
+    // Bump the version when the layout of BookEntry changes.
+    const char MAGIC[8] = {'C', 'K', 'R', 'B', 'O', 'O', 'K', '1'};
+
+    struct BookHeader
+    {
+      char magic[8];
+      uint64_t count;
+    };
+
+    bool key_less(const BookEntry &a, const BookEntry &b)
+    {
+      return a.key < b.key;
+    }
+  }
+
+  Book::Book() : entries(nullptr), count(0) {}
+
+  bool Book::open(const string &path)
+  {
+    this->close();
+    if (!this->file.open(path)) {
+      return false;
+    }
+    const BookHeader *header =
+      static_cast<const BookHeader*>(this->file.data());
+    if (this->file.size() < sizeof(BookHeader) ||
+	memcmp(header->magic, MAGIC, sizeof(MAGIC)) ||
+	this->file.size() !=
+	sizeof(BookHeader) + header->count * sizeof(BookEntry)) {
+      this->file.close();
+      return false;
+    }
+    this->entries = reinterpret_cast<const BookEntry*>(header + 1);
+    this->count = header->count;
+    return true;
+  }
+
+  void Book::close()
+  {
+    this->file.close();
+    this->entries = nullptr;
+    this->count = 0;
+  }
+
+  bool Book::is_open() const
+  {
+    return this->file.is_open();
+  }
+
+  const BookEntry* Book::find(uint64_t key) const
+  {
+    BookEntry probe;
+    probe.key = key;
+    const BookEntry *it = lower_bound(this->begin(), this->end(), probe,
+				      key_less);
+    return it != this->end() && it->key == key ? it : nullptr;
+  }
+
+  const BookEntry* Book::begin() const
+  {
+    return this->entries;
+  }
+
+  const BookEntry* Book::end() const
+  {
+    return this->entries + this->count;
+  }
+
+  size_t Book::size() const
+  {
+    return this->count;
+  }
+
+  const BookEntry& merge_entries(const BookEntry &a, const BookEntry &b)
+  {
+    return b.visit_count > a.visit_count ? b : a;
+  }
+
+  bool write_book(const string &path, vector<BookEntry> entries)
+  {
+    stable_sort(entries.begin(), entries.end(), key_less);
+    size_t n = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (n && entries[n - 1].key == entries[i].key) {
+	entries[n - 1] = merge_entries(entries[n - 1], entries[i]);
+      }
+      else {
+	entries[n++] = entries[i];
+      }
+    }
+    entries.resize(n);
+
+    string tmp_path = path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+      return false;
+    }
+    BookHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.count = n;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+      fwrite(entries.data(), sizeof(BookEntry), n, f) == n;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str())) {
+      remove(tmp_path.c_str());
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "book.h"
+
+using namespace std;
+using namespace checkers;
+
+// Folds books into one, e.g. the position store dumped by a session
+// of mcts_checkers back into the book it started from:
+//
+//   book_merge book.bin book.bin session.bin
+//
+// Positions found in several inputs keep the entry with the most
+// visits. The output may also be one of the inputs.
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    cerr << "usage: " << argv[0] << " OUTPUT INPUT..." << endl;
+    return 1;
+  }
+
+  vector<BookEntry> entries;
+  for (int i = 2; i < argc; ++i) {
+    Book book;
+    if (!book.open(argv[i])) {
+      cerr << "can't read book " << argv[i] << endl;
+      return 1;
+    }
+    cout << argv[i] << ": " << book.size() << " positions" << endl;
+    entries.insert(entries.end(), book.begin(), book.end());
+  }
+
+  if (!write_book(argv[1], entries)) {
+    cerr << "can't write book " << argv[1] << endl;
+    return 1;
+  }
+  Book merged;
+  merged.open(argv[1]);
+  cout << argv[1] << ": " << merged.size() << " positions" << endl;
+  return 0;
+}
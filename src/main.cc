@@ -1,30 +1,113 @@
 #include <iostream>
+#include <cstring>
+#include <fstream>
 #include <string>
 #include "board.h"
+#include "book.h"
 #include "mcts.h"
 #include "minimax.h"
 #include "state.h"
+#include "stats.h"
+#include "tablebase.h"
 
 using namespace std;
 using namespace checkers;
 using namespace MCTS;
 
-// The minimax agent only checks the time between each search
-// iteration (iterative deepening), so it may exceed the time limit
-// set here. That's why we give it less time than MCTS.
+// The minimax agent abandons an iteration of iterative deepening
+// that runs past its time limit, so it overshoots by well under a
+// millisecond. It still gets less time than MCTS, as it always has.
 #define MINIMAX_TIME_LIMIT 1000
 
+// Number of threads running the minimax search (Lazy SMP). 0 uses
+// every core.
+#define MINIMAX_THREADS 0
+
 // MCTS doesn't really exceed its time limit (maybe by a few ms in the
 // worst case).
 #define MCTS_TIME_LIMIT 5000
 
-int main()
+// Number of threads searching the MCTS tree. 0 uses every core.
+#define MCTS_THREADS 0
+
+// Either tree_parallel (one shared tree) or root_parallel (one tree
+// per thread).
+#define MCTS_PARALLELISM tree_parallel
+
+// Memory cap of the MCTS statistics kept between moves, and which
+// entries to evict once it is reached: keep_recent, keep_visited or
+// keep_shallow.
+#define MCTS_STORE_BYTES (size_t(256) << 20)
+#define MCTS_STORE_POLICY keep_recent
+
+// Usage: mcts_checkers [-b BOOK] [-t TABLEBASE] [-s SESSION] [-j STATS]
+//
+// BOOK is a book file (see book.h) both agents consult, and TABLEBASE
+// an endgame tablebase made by tbgen (see tablebase.h). SESSION is
+// where the MCTS store is written when the game ends, to be folded
+// into a book with book_merge. The statistics of every search are
+// appended to STATS, one JSON object per line.
+int main(int argc, char **argv)
 {
+  Book book;
+  Tablebase tablebase;
+  string session_path;
+  ofstream stats_file;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      if (!book.open(argv[++i])) {
+	cerr << "can't read book " << argv[i] << endl;
+	return 1;
+      }
+      cout << "book: " << book.size() << " positions" << endl;
+    }
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      if (!tablebase.open(argv[++i])) {
+	cerr << "can't read tablebase " << argv[i] << endl;
+	return 1;
+      }
+      cout << "tablebase: up to " << tablebase.max_pieces() << " pieces" <<
+	endl;
+    }
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      session_path = argv[++i];
+    }
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+      stats_file.open(argv[++i], ios::app);
+      if (!stats_file) {
+	cerr << "can't write stats to " << argv[i] << endl;
+	return 1;
+      }
+    }
+    else {
+      cerr << "usage: " << argv[0] <<
+	" [-b BOOK] [-t TABLEBASE] [-s SESSION] [-j STATS]" << endl;
+      return 1;
+    }
+  }
+  const Book *book_ptr = book.is_open() ? &book : nullptr;
+  const Tablebase *tablebase_ptr =
+    tablebase.is_open() ? &tablebase : nullptr;
+
+  MCTS::Options mcts_options;
+  mcts_options.num_threads = MCTS_THREADS;
+  mcts_options.parallelism = MCTS_PARALLELISM;
+  mcts_options.store_bytes = MCTS_STORE_BYTES;
+  mcts_options.store_policy = MCTS_STORE_POLICY;
+  mcts_options.book = book_ptr;
+  mcts_options.tablebase = tablebase_ptr;
+
+  MinimaxOptions minimax_options;
+  minimax_options.num_threads = MINIMAX_THREADS;
+  minimax_options.book = book_ptr;
+  minimax_options.tablebase = tablebase_ptr;
+
   // Initial state
   State s;
   s.print();
 
   // Run a game
+  SearchStats stats;
   for (int i = 0; ; ++i) {
     auto actions = s.board.legal_actions(s.get_cur_player());
     if (actions.size() == 1) {
@@ -37,7 +120,8 @@ int main()
     else {
       if (i % 2) {
 	// Player 2 uses minimax.
-	auto action_score = ABS_deepening(s, MINIMAX_TIME_LIMIT);
+	auto action_score =
+	  ABS_deepening(s, MINIMAX_TIME_LIMIT, minimax_options, &stats);
 	auto action = action_score.first;
 	auto score = action_score.second;
 	cout << "minimax: " << action << " " << score << endl;
@@ -45,7 +129,7 @@ int main()
       }
       else {
 	// Player 1 uses MCTS.
-	auto action = UCTSearch(s, MCTS_TIME_LIMIT);
+	auto action = UCTSearch(s, MCTS_TIME_LIMIT, mcts_options, &stats);
 	cout << "mcts: " << action << endl;
 	s.apply_action(action);
 
@@ -58,10 +142,18 @@ int main()
 	// cout << "mcts: " << a << endl;
 	// s.apply_action(a);
       }
+      stats.print();
+      if (stats_file.is_open()) {
+	stats.write_json(stats_file);
+      }
     }
     s.print();
     // cin.ignore();
   }
 
+  if (!session_path.empty() && !save_store(session_path)) {
+    cerr << "can't write session " << session_path << endl;
+    return 1;
+  }
   return 0;
 }
@@ -0,0 +1,67 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mapped_file.h"
+
+using namespace std;
+
+namespace checkers
+{
+  MappedFile::MappedFile() : addr(nullptr), length(0) {}
+
+  MappedFile::~MappedFile()
+  {
+    this->close();
+  }
+
+  bool MappedFile::open(const string &path)
+  {
+    this->close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    size_t length = st.st_size;
+    void *addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      return false;
+    }
+    // Lookups jump around the file, so reading ahead is wasted.
+    madvise(addr, length, MADV_RANDOM);
+    this->addr = addr;
+    this->length = length;
+    return true;
+  }
+
+  void MappedFile::close()
+  {
+    if (this->addr) {
+      munmap(this->addr, this->length);
+    }
+    this->addr = nullptr;
+    this->length = 0;
+  }
+
+  bool MappedFile::is_open() const
+  {
+    return this->addr != nullptr;
+  }
+
+  const void* MappedFile::data() const
+  {
+    return this->addr;
+  }
+
+  size_t MappedFile::size() const
+  {
+    return this->length;
+  }
+}
@@ -1,15 +1,27 @@
 #include <chrono>
 #include <cmath>
-#include <map>
 #include <random>
+#include <omp.h>
 #include "mcts.h"
+#include "rollout.h"
+#include "stats.h"
+#include "store.h"
+#include "util.h"
 
 using namespace std;
+using namespace util;
 
 #define C_p (1.0 / sqrt(2))
 
-#define NONTERMINAL(node) \
-  (!node->unvisited_actions.empty() || !node->children.empty())
+// Reward subtracted from every node on a path while a playout from
+// it is in flight, so that other threads prefer different branches.
+// It is given back in Backup.
+#define VIRTUAL_LOSS 1.0
+
+// How many plies below the previous root UCTSearch looks for the new
+// root state. Two covers our move and the opponent's reply; more
+// allow for forced moves that were played without searching.
+#define MAX_REUSE_DEPTH 4
 
 namespace checkers
 {
@@ -17,139 +29,596 @@ namespace checkers
   {
     namespace
     {
-      static auto gen = ranlux48_base(random_device()());
-      static auto dist = uniform_real_distribution<>(0.0, 1.0);
+      uint64_t random_seed()
+      {
+	random_device rd;
+	return (uint64_t(rd()) << 32) | rd();
+      }
 
-      static map<State, pair<double, int>> store;
+      thread_local Rng rng(random_seed());
 
-      void update_store(const Node *node)
+      static Context default_context;
+
+      // The context of the search this thread works on and the book
+      // and tablebase it was given. Set by every thread of a search.
+      thread_local Context *context = &default_context;
+      thread_local const Book *book = nullptr;
+      thread_local const Tablebase *tablebase = nullptr;
+      thread_local bool solver = false;
+
+      // Walks the tree making and taking back the actions on state,
+      // which ends up unchanged.
+      void update_store(const Node *node, State &state, int depth)
       {
-	if (store.count(node->state)) {
-	  store.at(node->state) =
-	    make_pair(node->total_reward, node->visit_count);
+	uint32_t best_action = 0;
+	unsigned int best_visits = 0;
+	for (unsigned int i = 0; i < node->num_visited(); ++i) {
+	  const Node *child = &node->children[i];
+	  if (child->visit_count > best_visits) {
+	    best_visits = child->visit_count;
+	    best_action = child->action.id();
+	  }
 	}
-	else {
-	  store.emplace(node->state,
-			make_pair(node->total_reward,
-				  node->visit_count));
+	// The entry is only valid until the next insert.
+	StoreEntry &e = context->store.insert(state.hash(), depth);
+	e.total_reward = node->total_reward;
+	e.visit_count = node->visit_count;
+	e.best_action = best_action;
+	for (unsigned int i = 0; i < node->num_visited(); ++i) {
+	  const Node *child = &node->children[i];
+	  Undo undo = state.apply_action(child->action);
+	  update_store(child, state, depth + 1);
+	  state.undo_action(child->action, undo);
+	}
+      }
+
+      // Load a node's statistics from the store, or else the book
+      void load_node(Node *node, const State &s)
+      {
+	const StoreEntry *e = context->store.find(s.hash());
+	if (e) {
+	  node->total_reward = e->total_reward;
+	  node->visit_count = e->visit_count;
+	}
+	else if (book) {
+	  const BookEntry *b = book->find(s.hash());
+	  if (b) {
+	    node->total_reward = b->total_reward;
+	    node->visit_count = b->visit_count;
+	  }
+	}
+      }
+
+      // Proves a node whose position is decided: the player to move
+      // has no actions, which is found without generating them, or
+      // it's won or lost in the tablebase. Children are proven this
+      // way when first visited, so a move that ends the game is seen
+      // as soon as its siblings are.
+      void probe_node(Node *node, const State &s)
+      {
+	TBValue value;
+	if (s.board.mobility(s.get_cur_player()) == immobile) {
+	  node->proof_plies = 0;
+	  node->proof = Node::proven_win;
+	}
+	else if (tablebase && tablebase->probe(s, value) &&
+		 value.outcome != draw) {
+	  // The tablebase gives the value for the player to move.
+	  node->proof_plies = value.distance;
+	  node->proof = value.outcome == loss ? Node::proven_win :
+	    Node::proven_loss;
+	}
+      }
+
+      // Proves node from its children if they allow it: lost if the
+      // player to move has a winning move, taking the quickest win,
+      // and won if every move loses, taking the slowest loss. Returns
+      // whether node is proven. A win is proven as soon as one is
+      // found, which prunes it in the parent, but until every child
+      // has been visited a quicker one may turn up (see settled).
+      bool prove_from_children(Node *node)
+      {
+	bool all_lost = node->fully_expanded(), won = false;
+	unsigned int win_plies = 0, loss_plies = 0;
+	for (unsigned int i = 0; i < node->num_visited(); ++i) {
+	  const Node *child = &node->children[i];
+	  Node::Proof proof = child->proof;
+	  unsigned int plies = child->proof_plies + 1;
+	  if (proof == Node::proven_win) {
+	    win_plies = won ? min(win_plies, plies) : plies;
+	    won = true;
+	  }
+	  else if (proof == Node::proven_loss) {
+	    loss_plies = max(loss_plies, plies);
+	  }
+	  else {
+	    all_lost = false;
+	  }
 	}
-	for (auto it = node->children.begin();
-	     it != node->children.end(); ++it) {
-	  update_store(*it);
+	if (won || all_lost) {
+	  node->proof_plies = won ? win_plies : loss_plies;
+	  node->proof = won ? Node::proven_loss : Node::proven_win;
 	}
+	return won || all_lost;
+      }
+
+      // Whether node is proven for good, with the final proof_plies:
+      // by the tablebase, before it's expanded, or once every child
+      // has been visited. A settled node is a leaf of the search.
+      inline bool settled(const Node *node)
+      {
+	return node->proof != Node::unproven &&
+	  (!node->is_expanded() || node->fully_expanded());
       }
 
-      // Load a node from the store
-      Node* load_node(Node *parent, const State &s, const Action &a)
+      // What a playout from a proven node would return.
+      inline double proven_reward(Node::Proof proof)
       {
-      	Node *node = new Node(parent, s, a);
-      	if (store.count(s)) {
-      	  auto p = store[s];
-      	  node->total_reward = p.first;
-      	  node->visit_count = p.second;
-      	  node->avg_reward = p.first / p.second;
-      	}
-      	return node;
+	return proof == Node::proven_win ? 1.0 : 0.0;
+      }
+
+      // Time spent in each phase of the iterations of one thread, in
+      // seconds. tree covers selection and expansion.
+      struct Phases
+      {
+	Phases() : tree(0.0), expansion(0.0), playout(0.0), backup(0.0) {}
+	double tree, expansion, playout, backup;
+      };
+
+      // Adds the time from its construction to its destruction to
+      // *seconds. Does nothing, not even read the clock, if seconds is
+      // null.
+      class PhaseTimer
+      {
+      public:
+	PhaseTimer(double *seconds) : seconds(seconds)
+	{
+	  if (seconds) {
+	    this->start = chrono::steady_clock::now();
+	  }
+	}
+	~PhaseTimer()
+	{
+	  if (this->seconds) {
+	    *this->seconds += chrono::duration<double>
+	      (chrono::steady_clock::now() - this->start).count();
+	  }
+	}
+      private:
+	double *seconds;
+	chrono::steady_clock::time_point start;
+      };
+
+      // The chosen action followed by the most visited line of play
+      // after it.
+      vector<Action> principal_variation(const Node *root,
+					 const Action &best)
+      {
+	vector<Action> pv;
+	const Node *node = nullptr;
+	for (unsigned int i = 0; i < root->num_visited(); ++i) {
+	  if (root->children[i].action == best) {
+	    node = &root->children[i];
+	    pv.push_back(best);
+	  }
+	}
+	while (node && node->num_visited()) {
+	  const Node *best = &node->children[0];
+	  for (unsigned int i = 1; i < node->num_visited(); ++i) {
+	    if (node->children[i].visit_count > best->visit_count) {
+	      best = &node->children[i];
+	    }
+	  }
+	  pv.push_back(best->action);
+	  node = best;
+	}
+	return pv;
+      }
+
+      void add_virtual_loss(Node *node)
+      {
+	++node->visit_count;
+	atomic_add(node->total_reward, -VIRTUAL_LOSS);
+      }
+
+      // UCB1 value of a child with the given statistics.
+      inline double uct_value(double total_reward, unsigned int visits,
+			      double log_parent_visits)
+      {
+	return total_reward / visits +
+	  C_p * sqrt((2 * log_parent_visits) / visits);
+      }
+
+      // Picks a move from the root statistics of independent trees
+      // of the same state, summing the visits and rewards of each
+      // root action over all trees. The roots list their actions in
+      // the same order since action generation is deterministic.
+      Action merged_best_action(const vector<Node*> &roots)
+      {
+	double parent_visits = 0.0;
+	for (auto it = roots.begin(); it != roots.end(); ++it) {
+	  parent_visits += (*it)->visit_count;
+	}
+	double log_parent_visits = log(parent_visits);
+	double best_value = numeric_limits<double>::lowest();
+	Action best = Action::nil(), best_candidate = Action::nil();
+	unsigned int num_actions = 0;
+	for (auto it = roots.begin(); it != roots.end(); ++it) {
+	  num_actions = max<unsigned int>(num_actions, (*it)->num_visited());
+	}
+	// Every tree agrees on the proofs, since they are exact. Lost
+	// actions are only taken if they all are.
+	double best_lost_value = numeric_limits<double>::lowest();
+	Action best_lost = Action::nil(), best_won = Action::nil();
+	unsigned int best_won_plies = 0;
+	for (unsigned int i = 0; i < num_actions; ++i) {
+	  double total_reward = 0.0;
+	  unsigned int visits = 0, plies = 0;
+	  Node::Proof proof = Node::unproven;
+	  for (auto it = roots.begin(); it != roots.end(); ++it) {
+	    if (i < (*it)->num_visited()) {
+	      const Node *child = &(*it)->children[i];
+	      total_reward += child->total_reward;
+	      visits += child->visit_count;
+	      best_candidate = child->action;
+	      if (solver && child->proof != Node::unproven) {
+		proof = child->proof;
+		plies = child->proof_plies;
+	      }
+	    }
+	  }
+	  if (proof == Node::proven_win) {
+	    if (best_won == Action::nil() || plies < best_won_plies) {
+	      best_won = best_candidate;
+	      best_won_plies = plies;
+	    }
+	    continue;
+	  }
+	  if (!visits) {
+	    continue;
+	  }
+	  double value = uct_value(total_reward, visits, log_parent_visits);
+	  if (proof == Node::proven_loss) {
+	    if (value > best_lost_value) {
+	      best_lost_value = value;
+	      best_lost = best_candidate;
+	    }
+	  }
+	  else if (value > best_value) {
+	    best_value = value;
+	    best = best_candidate;
+	  }
+	}
+	if (best_won != Action::nil()) {
+	  return best_won;
+	}
+	return best == Action::nil() ? best_lost : best;
       }
     }
 
     // Forward declare everything used by UCTSearch.
-    Node* TreePolicy(Node *root);
-    Node* Expand(Node *root);
+    Node* TreePolicy(Node *root, State &state, Arena &arena,
+		     Phases *phases);
+    Node* Expand(Node *root, State &state);
     Node* BestChild(const Node *node);
     double DefaultPolicy(const State &state);
     void Backup(Node *node, double reward);
 
-    // The primary search function to be used from outside.
-    Action UCTSearch(const State &state, int time_limit_ms)
+    // The primary search function to be used from outside. With
+    // tree parallelism all threads work on the same tree. With root
+    // parallelism each thread grows its own tree and the root
+    // statistics are merged at the end. Phases are only timed when
+    // stats are requested.
+    Action UCTSearch(const State &state, int time_limit_ms,
+		     const Options &options, SearchStats *stats)
     {
-      // Load the root node from the store if possible.
-      Node *root = load_node(nullptr, state, Action::nil());
-      int count = 0;
+      int num_threads = options.num_threads > 0 ? options.num_threads :
+	omp_get_max_threads();
+      Context &ctx = options.context ? *options.context : default_context;
+      Context *previous_context = context;
+      const Book *previous_book = book;
+      const Tablebase *previous_tablebase = tablebase;
+      context = &ctx;
+      book = options.book;
+      tablebase = options.tablebase;
+      bool previous_solver = solver;
+      solver = options.solver;
+      Store &store = ctx.store;
+      vector<Arena> &arenas = ctx.arenas, &spare_arenas = ctx.spare_arenas;
+      store.set_max_bytes(options.store_bytes);
+      store.set_policy(options.store_policy);
+      int num_trees =
+	options.parallelism == root_parallel ? num_threads : 1;
+      if (arenas.size() < static_cast<size_t>(num_threads)) {
+	arenas.resize(num_threads);
+	spare_arenas.resize(num_threads);
+      }
+      // Keep the subtree of the previous search that starts at this
+      // state and drop the rest of it.
+      Node *reused = nullptr;
+      if (ctx.saved_root && num_trees == 1) {
+	Node *match =
+	  find_state(ctx.saved_root, ctx.saved_state, state, MAX_REUSE_DEPTH);
+	if (match) {
+	  reused = clone_tree(spare_arenas[0], nullptr, match);
+	}
+      }
+      for (auto it = arenas.begin(); it != arenas.end(); ++it) {
+	it->reset();
+      }
+      arenas.swap(spare_arenas);
+      ctx.saved_root = nullptr;
+      // Otherwise load the root nodes from the store if possible.
+      vector<Node*> roots;
+      for (int k = 0; k < num_trees; ++k) {
+	if (reused) {
+	  roots.push_back(reused);
+	}
+	else {
+	  roots.push_back(arenas[k].make<Node>());
+	  load_node(roots.back(), state);
+	}
+      }
+      // A root proven as a leaf of the last search, by the tablebase,
+      // has no children to play; it's proven again from them.
+      for (auto it = roots.begin(); it != roots.end(); ++it) {
+	(*it)->proof = Node::unproven;
+      }
+      size_t reused_nodes = reused ? arenas[0].num_objects() : 0;
+      StoreStats store_before = store.stats();
+      unsigned long count = 0;
+      Phases phases;
 
       auto start_time = chrono::steady_clock::now();
-      while (chrono::duration_cast<chrono::milliseconds>
-	     (chrono::steady_clock::now() - start_time).count() <
-	     time_limit_ms) {
-	Node *v = TreePolicy(root);
-	double reward = DefaultPolicy(v->state);
-	Backup(v, reward);
-	++count;
-      }
-
-      cout << "mcts ran for " << count << " iterations" << endl;
-      cout << "tree depth: " << tree_depth(root) << endl;
-      cout << "updating store..." << endl;
-      update_store(root);
-      cout << "store size: " << store.size() << endl;
-
-      Action best = BestChild(root)->action;
-      delete root;
+#pragma omp parallel num_threads(num_threads) reduction(+:count)
+      {
+	int thread = omp_get_thread_num();
+	context = &ctx;
+	book = options.book;
+	tablebase = options.tablebase;
+	solver = options.solver;
+	Node *root = roots[thread % num_trees];
+	Arena &arena = arenas[thread];
+	Phases local;
+	Phases *timed = stats ? &local : nullptr;
+	// Once the root is settled more iterations can't change the
+	// move.
+	while (chrono::duration_cast<chrono::milliseconds>
+	       (chrono::steady_clock::now() - start_time).count() <
+	       time_limit_ms && !(solver && settled(root))) {
+	  State s(state);
+	  Node *v;
+	  double reward;
+	  {
+	    PhaseTimer timer(timed ? &timed->tree : nullptr);
+	    v = TreePolicy(root, s, arena, timed);
+	  }
+	  {
+	    PhaseTimer timer(timed ? &timed->playout : nullptr);
+	    Node::Proof proof = v->proof;
+	    reward = solver && proof != Node::unproven ?
+	      proven_reward(proof) : DefaultPolicy(s);
+	  }
+	  {
+	    PhaseTimer timer(timed ? &timed->backup : nullptr);
+	    Backup(v, reward);
+	  }
+	  ++count;
+	}
+#pragma omp critical
+	{
+	  phases.tree += local.tree;
+	  phases.expansion += local.expansion;
+	  phases.playout += local.playout;
+	  phases.backup += local.backup;
+	}
+      }
+      double search_seconds = chrono::duration<double>
+	(chrono::steady_clock::now() - start_time).count();
+
+      StoreStats store_after = store.stats();
+      double store_seconds = 0.0;
+      {
+	PhaseTimer timer(&store_seconds);
+	// With several trees, positions they share keep the statistics
+	// of the last one.
+	store.new_search();
+	State s(state);
+	for (auto it = roots.begin(); it != roots.end(); ++it) {
+	  update_store(*it, s, 0);
+	}
+      }
+
+      Action best = num_trees == 1 ? BestChild(roots[0])->action :
+	merged_best_action(roots);
+
+      if (stats) {
+	*stats = SearchStats();
+	stats->algorithm = "mcts";
+	stats->action = best;
+	if (num_trees == 1) {
+	  stats->pv = principal_variation(roots[0], best);
+	}
+	stats->wall_ms = 1000.0 * (search_seconds + store_seconds);
+	stats->selection_ms = 1000.0 * (phases.tree - phases.expansion);
+	stats->expansion_ms = 1000.0 * phases.expansion;
+	stats->playout_ms = 1000.0 * phases.playout;
+	stats->backup_ms = 1000.0 * phases.backup;
+	stats->store_update_ms = 1000.0 * store_seconds;
+	stats->iterations = count;
+	stats->threads = num_threads;
+	for (auto it = roots.begin(); it != roots.end(); ++it) {
+	  stats->depth = max(stats->depth, tree_depth(*it));
+	}
+	for (int k = 0; k < num_threads; ++k) {
+	  stats->nodes += arenas[k].num_objects();
+	  stats->tree_bytes += arenas[k].bytes_used();
+	}
+	stats->reused_nodes = reused_nodes;
+	stats->peak_rss_bytes = peak_rss_bytes();
+	unsigned long lookups = store_after.lookups - store_before.lookups;
+	stats->store_hit_rate = lookups ?
+	  double(store_after.hits - store_before.hits) / lookups : 0.0;
+	StoreStats store_now = store.stats();
+	stats->store_size = store_now.size;
+	stats->store_capacity = store_now.capacity;
+	stats->store_bytes = store_now.bytes;
+	stats->store_occupancy = store_now.occupancy();
+	stats->store_evictions = store_now.evictions - store_before.evictions;
+      }
+
+      // A single tree is kept for the next search.
+      if (num_trees == 1) {
+	ctx.saved_root = roots[0];
+	ctx.saved_state = state;
+      }
+      else {
+	for (int k = 0; k < num_threads; ++k) {
+	  arenas[k].reset();
+	}
+      }
+      context = previous_context;
+      book = previous_book;
+      tablebase = previous_tablebase;
+      solver = previous_solver;
       return best;
     }
 
-    Node* TreePolicy(Node *root)
+    bool save_store(const string &path)
     {
-      while (NONTERMINAL(root)) {
-	if (!root->unvisited_actions.empty()) {
-	  return Expand(root);
+      const Store &store = default_context.store;
+      vector<BookEntry> entries;
+      entries.reserve(store.size());
+      for (auto it = store.begin(); it != store.end(); ++it) {
+	if (it->key) {
+	  BookEntry b;
+	  b.key = it->key;
+	  b.total_reward = it->total_reward;
+	  b.visit_count = it->visit_count;
+	  b.best_action = it->best_action;
+	  entries.push_back(b);
 	}
-	else {
-	  root = BestChild(root);
+      }
+      return write_book(path, entries);
+    }
+
+    // Descends to a node to run a playout from, applying virtual loss
+    // to every node on the way. state starts as the root state and is
+    // updated along the path, ending as the state of the node
+    // returned.
+    Node* TreePolicy(Node *root, State &state, Arena &arena,
+		     Phases *phases)
+    {
+      add_virtual_loss(root);
+      for (;;) {
+	// A proven node whose other children could still give a
+	// quicker win is searched on.
+	if (solver && settled(root)) {
+	  break;
+	}
+	bool expanded;
+	{
+	  PhaseTimer timer(phases && !root->is_expanded() ?
+			   &phases->expansion : nullptr);
+	  expanded = root->expand(state, arena);
+	}
+	// A node that another thread is expanding is treated as a leaf.
+	if (!expanded || root->terminal()) {
+	  break;
+	}
+	if (!root->fully_expanded()) {
+	  Node *child;
+	  {
+	    PhaseTimer timer(phases ? &phases->expansion : nullptr);
+	    child = Expand(root, state);
+	  }
+	  if (child) {
+	    add_virtual_loss(child);
+	    return child;
+	  }
+	  // Another thread claimed the last child first.
 	}
+	Node *child = BestChild(root);
+	if (!child) {
+	  // The remaining children are being loaded by other threads.
+	  return root;
+	}
+	state.apply_action(child->action);
+	root = child;
+	add_virtual_loss(root);
       }
       return root;
     }
 
-    Node* Expand(Node *root)
+    // Visits the next unvisited child of an expanded node for the
+    // first time, updating state to the child's state. Returns
+    // nullptr if another thread already claimed the last one.
+    Node* Expand(Node *root, State &state)
     {
-      Action a = root->unvisited_actions.back();
-      root->unvisited_actions.pop_back();
-      State s(root->state);
-      s.apply_action(a);
-      Node *child = load_node(root, s, a);
-      root->children.push_back(child);
+      unsigned int i = root->next_child++;
+      if (i >= root->num_children) {
+	return nullptr;
+      }
+      Node *child = &root->children[i];
+      state.apply_action(child->action);
+      load_node(child, state);
+      if (solver) {
+	probe_node(child, state);
+      }
       return child;
     }
 
+    // With the solver the quickest proven win is always taken, and
+    // proven losses only when every visited child is one.
     Node* BestChild(const Node *node)
     {
       double best_value = numeric_limits<double>::lowest();
-      Node *best_child = nullptr;
-      for (auto it = node->children.begin();
-	   it != node->children.end(); ++it) {
-	auto child = *it;
-	// Can the child's visit count ever be 0? Seems that a child
-	// is always visited when it is first created, so visit_count
-	// should always be at least 1.
-	double value = child->avg_reward +
-	  C_p * sqrt((2 * log(node->visit_count)) / child->visit_count);
-	if (value > best_value) {
+      double best_lost_value = best_value;
+      Node *best_child = nullptr, *best_lost = nullptr, *best_won = nullptr;
+      double log_visits = log(double(node->visit_count));
+      for (unsigned int i = 0; i < node->num_visited(); ++i) {
+	Node *child = &node->children[i];
+	// Skip children that another thread is still loading.
+	unsigned int visits = child->visit_count;
+	if (!visits) {
+	  continue;
+	}
+	Node::Proof proof = solver ? child->proof.load() : Node::unproven;
+	if (proof == Node::proven_win) {
+	  if (!best_won || child->proof_plies < best_won->proof_plies) {
+	    best_won = child;
+	  }
+	  continue;
+	}
+	double value = uct_value(child->total_reward, visits, log_visits);
+	if (proof == Node::proven_loss) {
+	  if (value > best_lost_value) {
+	    best_lost_value = value;
+	    best_lost = child;
+	  }
+	}
+	else if (value > best_value) {
 	  best_value = value;
 	  best_child = child;
 	}
       }
-      
+      if (best_won) {
+	return best_won;
+      }
       if (!best_child) {
+	best_child = best_lost;
+      }
+
+      if (!best_child && !node->num_visited()) {
 	cout << "WARNING: BestChild: returning null pointer" << endl;
       }
       return best_child;
     }
 
-    // Uniform random playout.
+    // Uniform random playout, cut short by the tablebase.
     double DefaultPolicy(const State &state)
     {
-      State s(state);
-      auto actions = s.board.legal_actions(s.get_cur_player());
-      while (!actions.empty()) {
-    	double x = dist(gen);
-    	int i = static_cast<int>(x * actions.size());
-    	Action a = actions[i];
-        s.apply_action(a);
-    	actions = s.board.legal_actions(s.get_cur_player());
-      }
-      // return s.get_cur_player() == state.get_cur_player() ? -1.0 : 1.0;
-      return s.get_cur_player() == state.get_cur_player() ? 1.0 : 0.0;
+      return 1.0 - random_playout(state, rng, tablebase);
     }
 
     // Piece differential board evaluation function.
@@ -159,14 +628,19 @@ namespace checkers
     //   return (-state.evaluate(state.get_cur_player()) + 15.0) / 30.0;
     // }
 
+    // The visits were already counted by TreePolicy, together with
+    // the virtual loss that is given back here. With the solver, a
+    // proven node may prove its parent, and so on up the path.
     void Backup(Node *node, double reward)
     {
+      bool proving = solver && node->proof != Node::unproven;
       while (node != nullptr) {
-	++node->visit_count;
-	node->total_reward += reward;
-	node->avg_reward = node->total_reward / node->visit_count;
+	atomic_add(node->total_reward, reward + VIRTUAL_LOSS);
 	reward = -reward;
 	node = node->parent;
+	if (proving && node) {
+	  proving = prove_from_children(node);
+	}
       }
     }
   }
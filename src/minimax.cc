@@ -1,101 +1,522 @@
+#include <atomic>
 #include <chrono>
 #include <iostream>
-#include <limits>
+#include <omp.h>
+#include "book.h"
+#include "stats.h"
 #include "minimax.h"
 #include "state.h"
+#include "ttable.h"
 #include "util.h"
 
 using namespace std;
 using namespace util;
 
-#define TERMINAL_SCORE 15
+// Scores are in the fixed-point units of Board::evaluate, where a
+// man is worth MAN_VALUE. A lost position scores -TERMINAL_SCORE,
+// far below any evaluation. Tablebase wins score TERMINAL_SCORE less
+// the distance to the end of the game in plies, so that the search
+// heads for the fastest win and the slowest loss.
+#define TERMINAL_SCORE 10000
+
+// Scores at least this large are proven wins or losses, which deeper
+// searches can't change.
+#define PROVEN_SCORE (TERMINAL_SCORE - 1000)
+
+// Beyond any score, for the initial alpha-beta window. Scores fit in
+// 16 bits in the transposition table.
+#define INFINITE_SCORE 32000
+
+// How often the search reads the clock, in nodes. A few hundred
+// microseconds at current speeds.
+#define DEADLINE_POLL_NODES 1024
+
+// Until ABS_deepening has timed three iterations it expects each to
+// take DEFAULT_GROWTH times longer than the previous one. It never
+// expects more than MAX_GROWTH times longer.
+#define DEFAULT_GROWTH 4.0
+#define MAX_GROWTH 16.0
+
+// Deepest iteration searched. Depths are stored in a signed char in
+// the transposition table.
+#define MAX_DEPTH 100
 
 namespace checkers
 {
-  // Iterative deepening.
-  pair<Action, double> ABS_deepening(const State &state, int time_limit_ms)
+  namespace
+  {
+    // Used by searches that aren't given a context. The transposition
+    // table is shared by all searches and threads of a context, so
+    // each iteration of iterative deepening and each new move starts
+    // from what earlier ones learned, and helper threads pass on what
+    // they find (Lazy SMP).
+    static MinimaxContext default_context;
+
+    // The context of the search this thread works on. Set by
+    // ABS_deepening on every thread of a search.
+    thread_local MinimaxContext *context = &default_context;
+
+    // Set by ABS_deepening on every thread of a search. The book
+    // suggests a first move to search in positions the transposition
+    // table knows nothing about, and the tablebase scores the
+    // positions it covers.
+    thread_local const Book *book = nullptr;
+    thread_local const Tablebase *tablebase = nullptr;
+
+    // Positions visited by ABS_max and ABS_min, and transposition
+    // table lookups, by this thread.
+    thread_local unsigned long nodes = 0, tt_probes = 0, tt_hits = 0;
+
+    // Hard time limit of ABS_deepening. Once stop is set, by the
+    // first thread to notice the deadline has passed or by the main
+    // thread when it is done, every search function returns at once
+    // with a meaningless result and without touching the
+    // transposition table.
+    inline bool stopped()
+    {
+      return context->stop.load(memory_order_relaxed);
+    }
+
+    // Called once per node, after counting it.
+    inline bool out_of_time()
+    {
+      if (context->deadline_active && nodes % DEADLINE_POLL_NODES == 0 &&
+	  chrono::steady_clock::now() >= context->deadline) {
+	context->stop = true;
+      }
+      return stopped();
+    }
+
+    // Killer moves are kept for this many plies from the root.
+    const int MAX_PLY = 128;
+
+    // Move ordering state. Killers are the last two quiet moves that
+    // caused a beta cutoff at each ply, and the history table scores
+    // moves by (from, to) square by how often and how deep they cut
+    // off. The counters measure how good the ordering is: ideally
+    // nearly every cutoff happens on the first move searched. Each
+    // thread orders moves on its own, which also makes helper threads
+    // search in different orders.
+    struct Ordering
+    {
+      uint32_t killers[MAX_PLY][2];
+      unsigned int history[32][32];
+      unsigned long cutoffs, first_move_cutoffs;
+    };
+
+    thread_local Ordering ordering;
+
+    // Clears the killers and counters and ages the history table so
+    // that it favors what was learned most recently.
+    void new_ordering()
+    {
+      for (int ply = 0; ply < MAX_PLY; ++ply) {
+	ordering.killers[ply][0] = ordering.killers[ply][1] = 0;
+      }
+      for (int s = 0; s < 32; ++s) {
+	for (int t = 0; t < 32; ++t) {
+	  ordering.history[s][t] /= 2;
+	}
+      }
+      ordering.cutoffs = ordering.first_move_cutoffs = 0;
+    }
+
+    // Sorts actions by the best move from the transposition table
+    // first, then the killers of this ply, then the history score.
+    void order_actions(ActionList &actions, uint32_t tt_move, int ply)
+    {
+      const unsigned int TT_SCORE = 1u << 31, KILLER_SCORE = 1u << 30;
+      unsigned int scores[MAX_ACTIONS];
+      for (int i = 0; i < actions.size; ++i) {
+	uint32_t id = actions[i].id();
+	unsigned int score = min(ordering.history[actions[i].from]
+				 [actions[i].to()], KILLER_SCORE - 1);
+	if (id == tt_move) {
+	  score = TT_SCORE;
+	}
+	else if (ply < MAX_PLY && (id == ordering.killers[ply][0] ||
+				   id == ordering.killers[ply][1])) {
+	  score = KILLER_SCORE + (id == ordering.killers[ply][0]);
+	}
+	// Insertion sort, the lists are short.
+	int j = i;
+	Action a = actions[i];
+	for (; j > 0 && scores[j - 1] < score; --j) {
+	  scores[j] = scores[j - 1];
+	  actions[j] = actions[j - 1];
+	}
+	scores[j] = score;
+	actions[j] = a;
+      }
+    }
+
+    // Called when the i-th action searched caused a beta cutoff.
+    void record_cutoff(const Action &a, int i, int d, int ply)
+    {
+      ++ordering.cutoffs;
+      if (i == 0) {
+	++ordering.first_move_cutoffs;
+      }
+      if (a.is_take()) {
+	return;
+      }
+      uint32_t id = a.id();
+      if (ply < MAX_PLY && ordering.killers[ply][0] != id) {
+	ordering.killers[ply][1] = ordering.killers[ply][0];
+	ordering.killers[ply][0] = id;
+      }
+      ordering.history[a.from][a.to()] += d > 0 ? d * d : 1;
+    }
+
+    // Looks up state in the transposition table. Returns true if the
+    // stored result for depth d settles the search within [alpha,
+    // beta], setting score and best (when the stored move is legal).
+    // Otherwise orders actions for searching, starting with the best
+    // move from the table or else from the book.
+    bool probe_tt(const State &state, ActionList &actions, int alpha,
+		  int beta, int d, int ply, int &score, Action &best)
+    {
+      TTEntry e;
+      bool hit = context->tt.probe(state.hash(), e);
+      ++tt_probes;
+      tt_hits += hit;
+      if (hit && e.depth >= d &&
+	  (e.bound == Bound::exact ||
+	   (e.bound == Bound::lower && e.score >= beta) ||
+	   (e.bound == Bound::upper && e.score <= alpha))) {
+	for (int i = 0; i < actions.size; ++i) {
+	  if (actions[i].id() == e.move) {
+	    score = e.score;
+	    best = actions[i];
+	    return true;
+	  }
+	}
+      }
+      uint32_t move = hit ? e.move : 0;
+      if (!move && book) {
+	const BookEntry *b = book->find(state.hash());
+	move = b ? b->best_action : 0;
+      }
+      order_actions(actions, move, ply);
+      return false;
+    }
+
+    // Looks up state in the tablebase, setting score from the point
+    // of view of the player to move on a hit. Never probes the root,
+    // which needs a move as well as a score.
+    bool probe_tablebase(const State &state, int ply, int &score)
+    {
+      TBValue value;
+      if (!tablebase || ply == 0 ||
+	  popcount(state.board.pieces_of(P1) | state.board.pieces_of(P2)) >
+	  tablebase->max_pieces() || !tablebase->probe(state, value)) {
+	return false;
+      }
+      score = value.outcome * (TERMINAL_SCORE - value.distance);
+      return true;
+    }
+
+    void store_tt(const State &state, int alpha, int beta, int d,
+		  int score, const Action &best)
+    {
+      Bound bound = score <= alpha ? Bound::upper :
+	score >= beta ? Bound::lower : Bound::exact;
+      context->tt.store(state.hash(), d, bound, score, best.id());
+    }
+
+    // The line of best moves stored in the transposition table,
+    // starting from state and at most max_length long.
+    vector<Action> principal_variation(State state, int max_length)
+    {
+      vector<Action> pv;
+      ActionList actions;
+      while (static_cast<int>(pv.size()) < max_length) {
+	TTEntry e;
+	if (!context->tt.probe(state.hash(), e) || !e.move) {
+	  break;
+	}
+	state.board.legal_actions(state.get_cur_player(), actions);
+	const Action *it = actions.begin();
+	while (it != actions.end() && it->id() != e.move) {
+	  ++it;
+	}
+	if (it == actions.end()) {
+	  break;
+	}
+	pv.push_back(*it);
+	state.apply_action(*it);
+      }
+      return pv;
+    }
+
+    // A Lazy SMP helper thread. Deepens on its own from one or two
+    // depths beyond start_depth until the main thread is done. What
+    // it finds only reaches the main thread through the
+    // transposition table.
+    void help(const State &state, int thread, int start_depth)
+    {
+      new_ordering();
+      int d = start_depth + 1 + thread % 2;
+      for (; d <= MAX_DEPTH && !stopped(); ++d) {
+	ABS(state, d);
+      }
+    }
+  }
+
+  // Iterative deepening with a hard deadline. An iteration that would
+  // likely not finish in time isn't started, and one that runs out of
+  // time is abandoned, leaving the result of the last completed depth.
+  // With several threads, the calling thread does this while the
+  // others help by filling the transposition table.
+  pair<Action, int> ABS_deepening(const State &state, int time_limit_ms,
+				  const MinimaxOptions &options,
+				  SearchStats *stats)
   {
+    int num_threads = options.num_threads > 0 ? options.num_threads :
+      omp_get_max_threads();
+    MinimaxContext &ctx =
+      options.context ? *options.context : default_context;
+    MinimaxContext *previous_context = context;
+    const Book *previous_book = book;
+    const Tablebase *previous_tablebase = tablebase;
+    context = &ctx;
+    book = options.book;
+    tablebase = options.tablebase;
+    ctx.tt.new_search();
+    new_ordering();
+    unsigned long nodes_before = nodes;
+    unsigned long probes_before = tt_probes, hits_before = tt_hits;
     auto start_time = chrono::steady_clock::now();
+    auto elapsed_ms = [&start_time]() {
+      return chrono::duration<double, milli>
+	(chrono::steady_clock::now() - start_time).count();
+    };
+    ctx.deadline = start_time + chrono::milliseconds(time_limit_ms);
+    ctx.stop = false;
+    // Depth 1 always completes so that there is a move to fall back on.
     int d = 1;
     auto move_score = ABS(state, d);
-    while (abs(move_score.second) != TERMINAL_SCORE &&
-	   chrono::duration_cast<chrono::milliseconds>
-	   (chrono::steady_clock::now() - start_time).count() <
-	   time_limit_ms) {
-      d += 1;
-      move_score = ABS(state, d);
-    }
-    cout << "reached depth " << d << endl;
+    // Time taken by each completed depth.
+    vector<double> iteration_ms(1, 0.0);
+    iteration_ms.push_back(elapsed_ms());
+    int aborted_depth = 0;
+    unsigned long total_nodes = 0, total_probes = 0, total_hits = 0;
+    ctx.deadline_active = true;
+    // Thread 0 deepens d while the helpers run, so they start from a
+    // copy taken before.
+    const int start_depth = d;
+#pragma omp parallel num_threads(num_threads) \
+  reduction(+:total_nodes, total_probes, total_hits)
+    {
+      int thread = omp_get_thread_num();
+      context = &ctx;
+      book = options.book;
+      tablebase = options.tablebase;
+      if (thread) {
+	unsigned long helper_nodes = nodes, helper_probes = tt_probes,
+	  helper_hits = tt_hits;
+	help(state, thread, start_depth);
+	total_nodes += nodes - helper_nodes;
+	total_probes += tt_probes - helper_probes;
+	total_hits += tt_hits - helper_hits;
+      }
+      else {
+	while (abs(move_score.second) < PROVEN_SCORE && d < MAX_DEPTH) {
+	  // Odd and even depths grow at different rates, so the next
+	  // iteration is predicted from the one two depths before it.
+	  double last = iteration_ms[d];
+	  double predicted = d >= 3 && iteration_ms[d - 2] > 0.0 ?
+	    iteration_ms[d - 1] * last / iteration_ms[d - 2] :
+	    DEFAULT_GROWTH * last;
+	  predicted = min(max(predicted, last), MAX_GROWTH * last);
+	  double iteration_start_ms = elapsed_ms();
+	  if (iteration_start_ms + predicted > time_limit_ms) {
+	    break;
+	  }
+	  auto result = ABS(state, d + 1);
+	  if (stopped()) {
+	    aborted_depth = d + 1;
+	    break;
+	  }
+	  d += 1;
+	  move_score = result;
+	  iteration_ms.push_back(elapsed_ms() - iteration_start_ms);
+	}
+	// Let the helpers go.
+	ctx.stop = true;
+	total_nodes += nodes - nodes_before;
+	total_probes += tt_probes - probes_before;
+	total_hits += tt_hits - hits_before;
+      }
+    }
+    ctx.deadline_active = false;
+    ctx.stop = false;
+    if (stats) {
+      *stats = SearchStats();
+      stats->algorithm = "minimax";
+      stats->action = move_score.first;
+      stats->score = move_score.second;
+      stats->wall_ms = elapsed_ms();
+      stats->threads = num_threads;
+      stats->depth = d;
+      stats->aborted_depth = aborted_depth;
+      stats->nodes = total_nodes;
+      stats->peak_rss_bytes = peak_rss_bytes();
+      stats->tt_hit_rate = total_probes ?
+	double(total_hits) / total_probes : 0.0;
+      if (ordering.cutoffs) {
+	stats->first_move_cutoff_rate =
+	  double(ordering.first_move_cutoffs) / ordering.cutoffs;
+      }
+      stats->pv = principal_variation(state, d);
+    }
+    context = previous_context;
+    book = previous_book;
+    tablebase = previous_tablebase;
     return move_score;
   }
 
+  void ABS_clear()
+  {
+    default_context.tt.clear();
+  }
+
+  unsigned long ABS_nodes()
+  {
+    return nodes;
+  }
+
   // Forward declares
-  pair<Action, double> ABS_max(const State&, double, double, int);
-  double ABS_min(const State&, double, double, int);
+  pair<Action, int> ABS_max(State&, int, int, int, int);
+  int ABS_min(State&, int, int, int, int);
 
   // Depth-limited search.
-  pair<Action, double> ABS(const State &state, int d)
+  // The search makes and takes back every move on a single copy of
+  // state. Children are searched with the action applied, and the
+  // action is taken back before looking at the result, even when the
+  // search is stopped.
+  pair<Action, int> ABS(const State &state, int d)
   {
-    return ABS_max(state, numeric_limits<double>::lowest(),
-		   numeric_limits<double>::max(), d);
+    State s(state);
+    return ABS_max(s, -INFINITE_SCORE, INFINITE_SCORE, d, 0);
   }
 
-  pair<Action, double>
-  ABS_max(const State &state, double alpha, double beta, int d)
+  pair<Action, int>
+  ABS_max(State &state, int alpha, int beta, int d, int ply)
   {
-    auto actions = state.board.legal_actions(state.get_cur_player());
+    ++nodes;
+    if (out_of_time()) {
+      return make_pair(Action::nil(), 0);
+    }
+    int tb_score;
+    if (probe_tablebase(state, ply, tb_score)) {
+      return make_pair(Action::nil(), tb_score);
+    }
+    // Quiet leaves are evaluated without generating their actions.
+    if (d <= 0) {
+      switch (state.board.mobility(state.get_cur_player())) {
+      case immobile:
+	return make_pair(Action::nil(), -TERMINAL_SCORE);
+      case moves_only:
+	return make_pair(Action::nil(),
+			 state.evaluate(state.get_cur_player()));
+      case must_take:
+	break;
+      }
+    }
+    ActionList actions;
+    state.board.legal_actions(state.get_cur_player(), actions);
     if (actions.empty()) {
       return make_pair(Action::nil(), -TERMINAL_SCORE);
     }
-    else if (d <= 0 && actions[0].moves[0].kind != MoveKind::take) {
-      return make_pair(Action::nil(), state.evaluate(P2));
-    }
     else {
-      double v = numeric_limits<double>::lowest();
+      int score;
+      Action best;
+      if (probe_tt(state, actions, alpha, beta, d, ply, score, best)) {
+	return make_pair(best, score);
+      }
+      int alpha_orig = alpha;
+      int v = -INFINITE_SCORE;
       int best_i = -1;
-      for (size_t i = 0; i < actions.size(); ++i) {
+      for (int i = 0; i < actions.size; ++i) {
 	auto action = actions[i];
-	State s(state);
-	s.apply_action(action);
-	double x = ABS_min(s, alpha, beta, d-1);
+	Undo undo = state.apply_action(action);
+	int x = ABS_min(state, alpha, beta, d-1, ply+1);
+	state.undo_action(action, undo);
+	if (stopped()) {
+	  return make_pair(Action::nil(), 0);
+	}
 	if (x > v) {
 	  v = x;
 	  best_i = i;
 	}
 	if (v >= beta) {
-	  return make_pair(actions[i], v);
+	  record_cutoff(action, i, d, ply);
+	  break;
 	}
 	alpha = max(alpha, v);
       }
+      store_tt(state, alpha_orig, beta, d, v, actions[best_i]);
       return make_pair(actions[best_i], v);
     }
   }
 
-  double
-  ABS_min(const State &state, double alpha, double beta, int d)
+  int
+  ABS_min(State &state, int alpha, int beta, int d, int ply)
   {
-    auto actions = state.board.legal_actions(state.get_cur_player());
+    ++nodes;
+    if (out_of_time()) {
+      return 0;
+    }
+    int tb_score;
+    if (probe_tablebase(state, ply, tb_score)) {
+      return -tb_score;
+    }
+    if (d <= 0) {
+      switch (state.board.mobility(state.get_cur_player())) {
+      case immobile:
+	return TERMINAL_SCORE;
+      case moves_only:
+	return state.evaluate(OTHER_PLAYER(state.get_cur_player()));
+      case must_take:
+	break;
+      }
+    }
+    ActionList actions;
+    state.board.legal_actions(state.get_cur_player(), actions);
     if (actions.empty()) {
       return TERMINAL_SCORE;
     }
-    else if (d <= 0 && actions[0].moves[0].kind != MoveKind::take) {
-      return state.evaluate(P2);
-    }
     else {
-      double v = numeric_limits<double>::max();
-      for (size_t i = 0; i < actions.size(); ++i) {
+      // The table holds scores for the player to move, which here is
+      // the minimizing one.
+      int score;
+      Action best;
+      if (probe_tt(state, actions, -beta, -alpha, d, ply, score, best)) {
+	return -score;
+      }
+      int beta_orig = beta;
+      int v = INFINITE_SCORE;
+      int best_i = -1;
+      for (int i = 0; i < actions.size; ++i) {
 	auto action = actions[i];
-	State s(state);
-	s.apply_action(action);
-	auto p = ABS_max(s, alpha, beta, d-1);
+	Undo undo = state.apply_action(action);
+	auto p = ABS_max(state, alpha, beta, d-1, ply+1);
+	state.undo_action(action, undo);
+	if (stopped()) {
+	  return 0;
+	}
 	if (p.second < v) {
 	  v = p.second;
+	  best_i = i;
 	}
 	if (v <= alpha) {
-	  return v;
+	  record_cutoff(action, i, d, ply);
+	  break;
 	}
 	beta = min(beta, v);
       }
+      store_tt(state, -beta_orig, -alpha, d, -v, actions[best_i]);
       return v;
     }
   }
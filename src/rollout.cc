@@ -0,0 +1,58 @@
+#include "rollout.h"
+
+namespace checkers
+{
+  // One ply of a playout, with P to move. Returns true if the game
+  // is decided, either by the tablebase or because P has no actions,
+  // and sets result to the result for P.
+  template <Player P>
+  bool playout_ply(Board &board, Rng &rng, const Tablebase *tablebase,
+		   double &result)
+  {
+    TBValue value;
+    if (tablebase &&
+	popcount(board.pieces[P1] | board.pieces[P2]) <=
+	tablebase->max_pieces() &&
+	tablebase->probe(board, P, value)) {
+      result = value.outcome == draw ? 0.5 : value.outcome == win ? 1.0 : 0.0;
+      return true;
+    }
+    Action action;
+    if (!board.random_action<P>(rng, action)) {
+      result = 0.0;
+      return true;
+    }
+    board.move_pieces(action);
+    return false;
+  }
+
+  namespace
+  {
+    // Plays a ply of P and then one of the other player each round,
+    // so both calls go to the kernel for their side and the player
+    // isn't looked at again.
+    template <Player P>
+    double playout(Board &board, Rng &rng, const Tablebase *tablebase)
+    {
+      double result;
+      while (true) {
+	if (playout_ply<P>(board, rng, tablebase, result)) {
+	  return result;
+	}
+	if (playout_ply<OTHER_PLAYER(P)>(board, rng, tablebase, result)) {
+	  return 1.0 - result;
+	}
+      }
+    }
+  }
+
+  // The copy is thrown away, so its hash isn't kept up to date.
+  double random_playout(const State &state, Rng &rng,
+			const Tablebase *tablebase)
+  {
+    Board board = state.board;
+    return state.get_cur_player() == P1 ?
+      playout<P1>(board, rng, tablebase) :
+      playout<P2>(board, rng, tablebase);
+  }
+}
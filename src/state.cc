@@ -1,6 +1,7 @@
 #include <cstring>
 #include "state.h"
 #include "util.h"
+#include "zobrist.h"
 
 using namespace std;
 using namespace util;
@@ -29,14 +30,27 @@ namespace checkers
     return this->cur_player;
   }
 
-  double State::evaluate(Player p) const
+  int State::evaluate(Player p) const
   {
     return this->board.evaluate(p);
   }
 
-  void State::apply_action(const Action &a)
+  uint64_t State::hash() const
   {
-    this->board.apply_action(a);
+    return this->board.hash() ^
+      (this->cur_player == P2 ? zobrist.p2_to_move : 0);
+  }
+
+  Undo State::apply_action(const Action &a)
+  {
+    Undo undo = this->board.apply_action(a);
+    next();
+    return undo;
+  }
+
+  void State::undo_action(const Action &a, const Undo &undo)
+  {
+    this->board.undo_action(a, undo);
     next();
   }
 
@@ -0,0 +1,102 @@
+#include <sstream>
+#include <sys/resource.h>
+#include "stats.h"
+
+using namespace std;
+
+namespace checkers
+{
+  SearchStats::SearchStats()
+    : action(Action::nil()), score(0.0), wall_ms(0.0), selection_ms(0.0),
+      expansion_ms(0.0), playout_ms(0.0), backup_ms(0.0),
+      store_update_ms(0.0), iterations(0), threads(0), depth(0),
+      aborted_depth(0), nodes(0), tree_bytes(0), reused_nodes(0),
+      peak_rss_bytes(0),
+      store_hit_rate(0.0), store_size(0), store_capacity(0),
+      store_bytes(0), store_occupancy(0.0), store_evictions(0),
+      tt_hit_rate(0.0), first_move_cutoff_rate(0.0) {}
+
+  void SearchStats::print() const
+  {
+    if (this->algorithm == "mcts") {
+      if (this->reused_nodes) {
+	cout << "reusing " << this->reused_nodes <<
+	  " nodes from the previous search" << endl;
+      }
+      cout << "mcts ran for " << this->iterations << " iterations on " <<
+	this->threads << " threads" << endl;
+      cout << "playouts per second: " <<
+	1000.0 * this->iterations / this->wall_ms << endl;
+      cout << "tree depth: " << this->depth << endl;
+      cout << "tree nodes: " << this->nodes << " (" << this->tree_bytes <<
+	" bytes)" << endl;
+      cout << "store size: " << this->store_size << " of " <<
+	this->store_capacity << " (" << this->store_bytes << " bytes, " <<
+	100.0 * this->store_occupancy << "% full)" << endl;
+      cout << "store hit rate: " << 100.0 * this->store_hit_rate << "%, " <<
+	this->store_evictions << " evictions" << endl;
+    }
+    else {
+      cout << "reached depth " << this->depth;
+      if (this->aborted_depth) {
+	cout << " (depth " << this->aborted_depth << " cut off)";
+      }
+      cout << endl;
+      cout << "cutoffs on first move: " <<
+	100.0 * this->first_move_cutoff_rate << "%" << endl;
+    }
+  }
+
+  namespace
+  {
+    string action_string(const Action &a)
+    {
+      ostringstream os;
+      os << a;
+      return os.str();
+    }
+  }
+
+  void SearchStats::write_json(ostream &os) const
+  {
+    os << "{\"algorithm\": \"" << this->algorithm << "\"" <<
+      ", \"action\": \"" << action_string(this->action) << "\"" <<
+      ", \"score\": " << this->score << ", \"pv\": [";
+    for (size_t i = 0; i < this->pv.size(); ++i) {
+      os << (i ? ", " : "") << '"' << action_string(this->pv[i]) << '"';
+    }
+    os << "], \"wall_ms\": " << this->wall_ms <<
+      ", \"phases_ms\": {\"selection\": " << this->selection_ms <<
+      ", \"expansion\": " << this->expansion_ms <<
+      ", \"playout\": " << this->playout_ms <<
+      ", \"backup\": " << this->backup_ms <<
+      ", \"store_update\": " << this->store_update_ms << "}" <<
+      ", \"iterations\": " << this->iterations <<
+      ", \"threads\": " << this->threads <<
+      ", \"depth\": " << this->depth <<
+      ", \"aborted_depth\": " << this->aborted_depth <<
+      ", \"nodes\": " << this->nodes <<
+      ", \"tree_bytes\": " << this->tree_bytes <<
+      ", \"reused_nodes\": " << this->reused_nodes <<
+      ", \"peak_rss_bytes\": " << this->peak_rss_bytes <<
+      ", \"store_hit_rate\": " << this->store_hit_rate <<
+      ", \"store_size\": " << this->store_size <<
+      ", \"store_capacity\": " << this->store_capacity <<
+      ", \"store_bytes\": " << this->store_bytes <<
+      ", \"store_occupancy\": " << this->store_occupancy <<
+      ", \"store_evictions\": " << this->store_evictions <<
+      ", \"tt_hit_rate\": " << this->tt_hit_rate <<
+      ", \"first_move_cutoff_rate\": " << this->first_move_cutoff_rate <<
+      "}" << endl;
+  }
+
+  size_t peak_rss_bytes()
+  {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) {
+      return 0;
+    }
+    // Linux reports kilobytes.
+    return size_t(usage.ru_maxrss) * 1024;
+  }
+}
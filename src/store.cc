@@ -0,0 +1,214 @@
+#include "store.h"
+
+using namespace std;
+
+namespace checkers
+{
+  namespace
+  {
+    const size_t INITIAL_CAPACITY = 1 << 16;
+
+    // Zero is reserved for empty slots.
+    inline uint64_t nonzero(uint64_t key)
+    {
+      return key ? key : 1;
+    }
+  }
+
+  double StoreStats::hit_rate() const
+  {
+    return this->lookups ? double(this->hits) / this->lookups : 0.0;
+  }
+
+  double StoreStats::occupancy() const
+  {
+    return this->capacity ? double(this->size) / this->capacity : 0.0;
+  }
+
+  Store::Store(size_t max_bytes, Replacement policy)
+    : count(0), max_bytes(max_bytes), policy(policy), generation(0),
+      lookups(0), hits(0), evictions(0)
+  {
+    this->entries.assign(min(INITIAL_CAPACITY, this->max_capacity()),
+			 StoreEntry());
+  }
+
+  // The largest power of two number of entries that fits in
+  // max_bytes, but at least one probe window.
+  size_t Store::max_capacity() const
+  {
+    size_t n = PROBE_WINDOW;
+    while (2 * n * sizeof(StoreEntry) <= this->max_bytes) {
+      n <<= 1;
+    }
+    return n;
+  }
+
+  const StoreEntry* Store::find(uint64_t key) const
+  {
+    key = nonzero(key);
+    this->lookups.fetch_add(1, memory_order_relaxed);
+    size_t mask = this->entries.size() - 1;
+    for (size_t k = 0; k < PROBE_WINDOW; ++k) {
+      const StoreEntry &e = this->entries[(key + k) & mask];
+      if (e.key == key) {
+	this->hits.fetch_add(1, memory_order_relaxed);
+	return &e;
+      }
+      if (!e.key) {
+	break;
+      }
+    }
+    return nullptr;
+  }
+
+  // Whether a should be evicted rather than b.
+  bool Store::evicts_before(const StoreEntry &a, const StoreEntry &b) const
+  {
+    switch (this->policy) {
+    case keep_shallow:
+      return a.depth > b.depth;
+    case keep_visited:
+      return a.visit_count < b.visit_count;
+    case keep_recent:
+    default:
+      unsigned short age_a = this->generation - a.generation;
+      unsigned short age_b = this->generation - b.generation;
+      return age_a != age_b ? age_a > age_b : a.visit_count < b.visit_count;
+    }
+  }
+
+  StoreEntry& Store::insert(uint64_t key, int depth)
+  {
+    key = nonzero(key);
+    for (;;) {
+      size_t mask = this->entries.size() - 1;
+      StoreEntry *slot = nullptr;
+      StoreEntry *victim = nullptr;
+      for (size_t k = 0; k < PROBE_WINDOW; ++k) {
+	StoreEntry &e = this->entries[(key + k) & mask];
+	if (e.key == key || !e.key) {
+	  slot = &e;
+	  break;
+	}
+	if (!victim || this->evicts_before(e, *victim)) {
+	  victim = &e;
+	}
+      }
+      bool can_grow = this->entries.size() < this->max_capacity();
+      if (slot && slot->key) {
+	slot->depth = depth;
+	slot->generation = this->generation;
+	return *slot;
+      }
+      // A full window only makes the table grow once it is half full,
+      // so that one unlucky cluster doesn't double it.
+      if (can_grow && (4 * (this->count + 1) > 3 * this->entries.size() ||
+		       (!slot && 2 * this->count > this->entries.size()))) {
+	this->rehash(2 * this->entries.size());
+	continue;
+      }
+      if (!slot) {
+	slot = victim;
+	++this->evictions;
+	--this->count;
+      }
+      slot->key = key;
+      slot->total_reward = 0.0;
+      slot->visit_count = 0;
+      slot->best_action = 0;
+      slot->depth = depth;
+      slot->generation = this->generation;
+      ++this->count;
+      return *slot;
+    }
+  }
+
+  void Store::new_search()
+  {
+    ++this->generation;
+  }
+
+  void Store::set_max_bytes(size_t max_bytes)
+  {
+    this->max_bytes = max_bytes;
+    if (this->entries.size() > this->max_capacity()) {
+      this->rehash(this->max_capacity());
+    }
+  }
+
+  void Store::set_policy(Replacement policy)
+  {
+    this->policy = policy;
+  }
+
+  size_t Store::size() const
+  {
+    return this->count;
+  }
+
+  size_t Store::capacity() const
+  {
+    return this->entries.size();
+  }
+
+  StoreStats Store::stats() const
+  {
+    StoreStats stats;
+    stats.lookups = this->lookups;
+    stats.hits = this->hits;
+    stats.evictions = this->evictions;
+    stats.size = this->count;
+    stats.capacity = this->entries.size();
+    stats.bytes = this->entries.size() * sizeof(StoreEntry);
+    return stats;
+  }
+
+  void Store::clear()
+  {
+    this->entries.assign(this->entries.size(), StoreEntry());
+    this->count = 0;
+    this->lookups = this->hits = 0;
+    this->evictions = 0;
+  }
+
+  const StoreEntry* Store::begin() const
+  {
+    return this->entries.data();
+  }
+
+  const StoreEntry* Store::end() const
+  {
+    return this->entries.data() + this->entries.size();
+  }
+
+  // Moves every entry into a table of the given capacity. Entries
+  // that don't fit in their new window are dropped and counted as
+  // evictions, which is rare unless the table shrinks.
+  void Store::rehash(size_t capacity)
+  {
+    vector<StoreEntry> old(capacity, StoreEntry());
+    old.swap(this->entries);
+    this->count = 0;
+    size_t mask = capacity - 1;
+    for (auto it = old.begin(); it != old.end(); ++it) {
+      if (!it->key) {
+	continue;
+      }
+      bool placed = false;
+      for (size_t k = 0; k < PROBE_WINDOW && !placed; ++k) {
+	StoreEntry &e = this->entries[(it->key + k) & mask];
+	if (!e.key) {
+	  e = *it;
+	  placed = true;
+	}
+      }
+      if (placed) {
+	++this->count;
+      }
+      else {
+	++this->evictions;
+      }
+    }
+  }
+}
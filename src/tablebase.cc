@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include "tablebase.h"
+
+using namespace std;
+
+namespace checkers
+{
+  namespace
+  {
+    // Bump the version when the layout or the indexing changes.
+    const char MAGIC[8] = {'C', 'K', 'R', 'T', 'B', 'S', '0', '1'};
+
+    struct TBHeader
+    {
+      char magic[8];
+      uint32_t max_pieces;
+      uint32_t num_tables;
+    };
+
+    // Followed by num_tables of these, then the tables themselves.
+    struct TBTableInfo
+    {
+      unsigned char counts[4]; // See Material
+      uint32_t reserved;
+      uint64_t offset; // From the start of the file
+      uint64_t size;
+    };
+
+    // Men never stand on the row where they are crowned, so each
+    // side's men are indexed over the 28 other squares.
+    const int MAN_SQUARES = 28;
+    const int KING_SQUARES = 32;
+
+    struct Binomials
+    {
+      uint64_t c[KING_SQUARES + 1][TABLEBASE_MAX_PIECES + 1];
+      Binomials()
+      {
+	for (int n = 0; n <= KING_SQUARES; ++n) {
+	  for (int k = 0; k <= TABLEBASE_MAX_PIECES; ++k) {
+	    c[n][k] = k == 0 ? 1 : n == 0 ? 0 : c[n - 1][k - 1] + c[n - 1][k];
+	  }
+	}
+      }
+    };
+
+    static const Binomials binomials;
+
+    // Men and kings of P1, then men and kings of P2.
+    struct Material
+    {
+      int counts[4];
+      int total() const
+      {
+	return counts[0] + counts[1] + counts[2] + counts[3];
+      }
+    };
+
+    const int NUM_MATERIAL_CODES = (TABLEBASE_MAX_PIECES + 1) *
+      (TABLEBASE_MAX_PIECES + 1) * (TABLEBASE_MAX_PIECES + 1) *
+      (TABLEBASE_MAX_PIECES + 1);
+
+    int material_code(const Material &m)
+    {
+      int code = 0;
+      for (int i = 0; i < 4; ++i) {
+	code = code * (TABLEBASE_MAX_PIECES + 1) + m.counts[i];
+      }
+      return code;
+    }
+
+    // The squares of each kind of piece, shifted so that men squares
+    // are numbered from 0 to MAN_SQUARES - 1.
+    void piece_sets(const Board &board, Bitboard sets[4])
+    {
+      Bitboard kings = board.king_squares();
+      sets[0] = board.pieces_of(P1) & ~kings;
+      sets[1] = board.pieces_of(P1) & kings;
+      sets[2] = (board.pieces_of(P2) & ~kings) >> 4;
+      sets[3] = board.pieces_of(P2) & kings;
+    }
+
+    Material material_of(const Bitboard sets[4])
+    {
+      Material m;
+      for (int i = 0; i < 4; ++i) {
+	m.counts[i] = popcount(sets[i]);
+      }
+      return m;
+    }
+
+    int squares_of(int kind)
+    {
+      return kind % 2 ? KING_SQUARES : MAN_SQUARES;
+    }
+
+    uint64_t table_size(const Material &m)
+    {
+      uint64_t size = 2;
+      for (int i = 0; i < 4; ++i) {
+	size *= binomials.c[squares_of(i)][m.counts[i]];
+      }
+      return size;
+    }
+
+    // Position of a set of squares among the sets of the same size,
+    // in the combinatorial number system.
+    uint64_t rank(Bitboard set)
+    {
+      uint64_t r = 0;
+      for (int i = 1; set; set &= set - 1, ++i) {
+	r += binomials.c[lsb(set)][i];
+      }
+      return r;
+    }
+
+    Bitboard unrank(uint64_t r, int k, int squares)
+    {
+      Bitboard set = 0;
+      int s = squares - 1;
+      for (int i = k; i > 0; --i) {
+	while (binomials.c[s][i] > r) {
+	  --s;
+	}
+	set |= square_bit(s);
+	r -= binomials.c[s][i];
+	--s;
+      }
+      return set;
+    }
+
+    uint64_t position_index(const Bitboard sets[4], const Material &m,
+			    Player to_move)
+    {
+      uint64_t index = 0;
+      for (int i = 0; i < 4; ++i) {
+	index = index * binomials.c[squares_of(i)][m.counts[i]] +
+	  rank(sets[i]);
+      }
+      return 2 * index + to_move;
+    }
+
+    // The position at index in the table of m. False for the indices
+    // that put two pieces on the same square.
+    bool position_at(uint64_t index, const Material &m, Board &board,
+		     Player &to_move)
+    {
+      to_move = static_cast<Player>(index % 2);
+      index /= 2;
+      Bitboard sets[4];
+      for (int i = 3; i >= 0; --i) {
+	uint64_t n = binomials.c[squares_of(i)][m.counts[i]];
+	sets[i] = unrank(index % n, m.counts[i], squares_of(i));
+	index /= n;
+      }
+      sets[2] <<= 4;
+      Bitboard p1 = sets[0] | sets[1], p2 = sets[2] | sets[3];
+      if (popcount(p1 | p2) != m.total()) {
+	return false;
+      }
+      board = Board(p1, p2, sets[1] | sets[3]);
+      return true;
+    }
+
+    // 0 is a draw, and also an unsettled position while generating.
+    // Otherwise the low 7 bits are the distance plus one, capped, and
+    // the high bit is set for losses.
+    unsigned char encode(Outcome outcome, int distance)
+    {
+      if (outcome == draw) {
+	return 0;
+      }
+      unsigned char d = min(distance, 126) + 1;
+      return outcome == loss ? 0x80 | d : d;
+    }
+
+    TBValue decode(unsigned char v)
+    {
+      TBValue value;
+      value.outcome = v == 0 ? draw : v & 0x80 ? loss : win;
+      value.distance = v == 0 ? 0 : (v & 0x7F) - 1;
+      return value;
+    }
+
+    // The entry of a position in tables, indexed by material code.
+    // nullptr if its table is missing.
+    const unsigned char*
+    find_entry(const vector<const unsigned char*> &tables,
+	       const Board &board, Player to_move)
+    {
+      Bitboard sets[4];
+      piece_sets(board, sets);
+      Material m = material_of(sets);
+      const unsigned char *table = tables[material_code(m)];
+      return table ? table + position_index(sets, m, to_move) : nullptr;
+    }
+
+    // The value of a position given those of its successors, or 0 if
+    // they don't settle it yet. Every successor is in a finished
+    // table, except those of the same material as the position.
+    unsigned char solve_position(const vector<const unsigned char*> &tables,
+				 const Board &board, Player to_move)
+    {
+      ActionList actions;
+      board.legal_actions(to_move, actions);
+      if (actions.empty()) {
+	return encode(loss, 0);
+      }
+      Player other = OTHER_PLAYER(to_move);
+      int fastest_win = INT_MAX, slowest_loss = 0;
+      bool all_lost = true;
+      Board b(board);
+      for (auto it = actions.begin(); it != actions.end(); ++it) {
+	Undo undo = b.apply_action(*it);
+	TBValue v = {loss, 0};
+	if (b.pieces_of(other)) {
+	  v = decode(*find_entry(tables, b, other));
+	}
+	b.undo_action(*it, undo);
+	if (v.outcome == loss) {
+	  fastest_win = min(fastest_win, v.distance + 1);
+	}
+	else if (v.outcome == win) {
+	  slowest_loss = max(slowest_loss, v.distance + 1);
+	}
+	else {
+	  all_lost = false;
+	}
+      }
+      if (fastest_win != INT_MAX) {
+	return encode(win, fastest_win);
+      }
+      return all_lost ? encode(loss, slowest_loss) : 0;
+    }
+
+    // Solves the table of m in place, once the tables of every
+    // material its positions can move to are done. Each pass settles
+    // the positions whose successors were settled by earlier passes;
+    // results are only written between passes, so the outcome
+    // doesn't depend on the number of threads. Whatever is left when
+    // a pass settles nothing is a draw.
+    void solve_table(const Material &m, vector<unsigned char> &table,
+		     vector<const unsigned char*> &tables, int num_threads)
+    {
+      auto start = chrono::steady_clock::now();
+      table.assign(table_size(m), 0);
+      tables[material_code(m)] = table.data();
+      vector<uint32_t> open;
+      for (uint64_t i = 0; i < table.size(); ++i) {
+	Board board;
+	Player to_move;
+	if (position_at(i, m, board, to_move)) {
+	  open.push_back(i);
+	}
+      }
+      size_t positions = open.size();
+      int passes = 0;
+      vector<pair<uint32_t, unsigned char>> settled;
+      do {
+	++passes;
+	settled.clear();
+#pragma omp parallel num_threads(num_threads)
+	{
+	  vector<pair<uint32_t, unsigned char>> mine;
+#pragma omp for schedule(dynamic, 1024)
+	  for (size_t i = 0; i < open.size(); ++i) {
+	    Board board;
+	    Player to_move;
+	    position_at(open[i], m, board, to_move);
+	    unsigned char v = solve_position(tables, board, to_move);
+	    if (v) {
+	      mine.push_back(make_pair(open[i], v));
+	    }
+	  }
+#pragma omp critical
+	  settled.insert(settled.end(), mine.begin(), mine.end());
+	}
+	for (auto &s : settled) {
+	  table[s.first] = s.second;
+	}
+	open.erase(remove_if(open.begin(), open.end(),
+			     [&table](uint32_t i) { return table[i] != 0; }),
+		   open.end());
+      } while (!settled.empty());
+
+      size_t wins = 0, losses = 0;
+      for (unsigned char v : table) {
+	wins += v && !(v & 0x80);
+	losses += (v & 0x80) != 0;
+      }
+      double seconds = chrono::duration<double>
+	(chrono::steady_clock::now() - start).count();
+      cout << m.counts[0] << m.counts[1] << m.counts[2] << m.counts[3] <<
+	": " << positions << " positions, " << wins << " wins, " <<
+	losses << " losses, " << positions - wins - losses << " draws, " <<
+	passes << " passes, " << seconds << " s" << endl;
+    }
+
+    // Every material with at least one piece per side, in an order
+    // where each comes after all those its positions can move to:
+    // captures remove pieces, and crowning turns a man into a king.
+    vector<Material> materials_to_solve(int max_pieces)
+    {
+      vector<Material> materials;
+      for (int code = 0; code < NUM_MATERIAL_CODES; ++code) {
+	Material m;
+	int c = code;
+	for (int i = 3; i >= 0; --i) {
+	  m.counts[i] = c % (TABLEBASE_MAX_PIECES + 1);
+	  c /= TABLEBASE_MAX_PIECES + 1;
+	}
+	if (m.total() <= max_pieces && m.counts[0] + m.counts[1] > 0 &&
+	    m.counts[2] + m.counts[3] > 0) {
+	  materials.push_back(m);
+	}
+      }
+      stable_sort(materials.begin(), materials.end(),
+		  [](const Material &a, const Material &b) {
+		    int a_men = a.counts[0] + a.counts[2];
+		    int b_men = b.counts[0] + b.counts[2];
+		    return a.total() < b.total() ||
+		      (a.total() == b.total() && a_men < b_men);
+		  });
+      return materials;
+    }
+  }
+
+  Tablebase::Tablebase() : pieces(0) {}
+
+  bool Tablebase::open(const string &path)
+  {
+    this->close();
+    if (!this->file.open(path)) {
+      return false;
+    }
+    const char *data = static_cast<const char*>(this->file.data());
+    size_t size = this->file.size();
+    const TBHeader *header = reinterpret_cast<const TBHeader*>(data);
+    if (size < sizeof(TBHeader) ||
+	memcmp(header->magic, MAGIC, sizeof(MAGIC)) ||
+	header->max_pieces > TABLEBASE_MAX_PIECES ||
+	size < sizeof(TBHeader) + header->num_tables * sizeof(TBTableInfo)) {
+      this->close();
+      return false;
+    }
+    this->tables.assign(NUM_MATERIAL_CODES, nullptr);
+    const TBTableInfo *info =
+      reinterpret_cast<const TBTableInfo*>(header + 1);
+    for (uint32_t i = 0; i < header->num_tables; ++i) {
+      Material m;
+      for (int j = 0; j < 4; ++j) {
+	m.counts[j] = info[i].counts[j];
+      }
+      if (m.total() > static_cast<int>(header->max_pieces) ||
+	  info[i].size != table_size(m) ||
+	  info[i].offset + info[i].size > size) {
+	this->close();
+	return false;
+      }
+      this->tables[material_code(m)] =
+	reinterpret_cast<const unsigned char*>(data + info[i].offset);
+    }
+    this->pieces = header->max_pieces;
+    return true;
+  }
+
+  void Tablebase::close()
+  {
+    this->file.close();
+    this->tables.clear();
+    this->pieces = 0;
+  }
+
+  bool Tablebase::is_open() const
+  {
+    return this->file.is_open();
+  }
+
+  int Tablebase::max_pieces() const
+  {
+    return this->pieces;
+  }
+
+  bool Tablebase::probe(const Board &board, Player to_move,
+			TBValue &value) const
+  {
+    if (popcount(board.pieces_of(P1) | board.pieces_of(P2)) > this->pieces) {
+      return false;
+    }
+    const unsigned char *entry = find_entry(this->tables, board, to_move);
+    if (!entry) {
+      return false;
+    }
+    value = decode(*entry);
+    return true;
+  }
+
+  bool Tablebase::probe(const State &state, TBValue &value) const
+  {
+    return this->probe(state.board, state.get_cur_player(), value);
+  }
+
+  bool generate_tablebase(const string &path, int max_pieces,
+			  int num_threads)
+  {
+    max_pieces = min(max(max_pieces, 2), TABLEBASE_MAX_PIECES);
+    if (num_threads <= 0) {
+      num_threads = omp_get_max_threads();
+    }
+    vector<Material> materials = materials_to_solve(max_pieces);
+    vector<vector<unsigned char>> data(NUM_MATERIAL_CODES);
+    vector<const unsigned char*> tables(NUM_MATERIAL_CODES, nullptr);
+    for (auto &m : materials) {
+      solve_table(m, data[material_code(m)], tables, num_threads);
+    }
+
+    TBHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.max_pieces = max_pieces;
+    header.num_tables = materials.size();
+    vector<TBTableInfo> infos;
+    uint64_t offset = sizeof(TBHeader) +
+      materials.size() * sizeof(TBTableInfo);
+    for (auto &m : materials) {
+      TBTableInfo info;
+      for (int j = 0; j < 4; ++j) {
+	info.counts[j] = m.counts[j];
+      }
+      info.reserved = 0;
+      info.offset = offset;
+      info.size = data[material_code(m)].size();
+      offset += info.size;
+      infos.push_back(info);
+    }
+
+    string tmp_path = path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+      return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+      fwrite(infos.data(), sizeof(TBTableInfo), infos.size(), f) ==
+      infos.size();
+    for (auto &m : materials) {
+      auto &table = data[material_code(m)];
+      ok = ok && fwrite(table.data(), 1, table.size(), f) == table.size();
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str())) {
+      remove(tmp_path.c_str());
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,35 @@
+#include <cstdlib>
+#include <iostream>
+#include "tablebase.h"
+
+using namespace std;
+using namespace checkers;
+
+// Generates an endgame tablebase for mcts_checkers -t:
+//
+//   tbgen tablebase.bin 4
+//
+// PIECES is the most pieces on the board the tablebase covers, 4 by
+// default. Each extra piece makes the tablebase tens of times larger
+// and slower to generate.
+int main(int argc, char **argv)
+{
+  int pieces = argc > 2 ? atoi(argv[2]) : 4;
+  if (argc < 2 || argc > 3 || pieces < 2 || pieces > TABLEBASE_MAX_PIECES) {
+    cerr << "usage: " << argv[0] << " OUTPUT [PIECES]" << endl;
+    return 1;
+  }
+
+  if (!generate_tablebase(argv[1], pieces)) {
+    cerr << "can't write tablebase " << argv[1] << endl;
+    return 1;
+  }
+  Tablebase tablebase;
+  if (!tablebase.open(argv[1])) {
+    cerr << "can't read tablebase " << argv[1] << endl;
+    return 1;
+  }
+  cout << argv[1] << ": up to " << tablebase.max_pieces() << " pieces" <<
+    endl;
+  return 0;
+}
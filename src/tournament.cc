@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <omp.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "book.h"
+#include "mcts.h"
+#include "minimax.h"
+#include "state.h"
+#include "stats.h"
+#include "tablebase.h"
+
+using namespace std;
+using namespace checkers;
+
+// Plays a match between two agents, many games at once, and reports
+// the score and Elo difference of the first agent:
+//
+//   tournament -g 200 mcts:1000 minimax:100
+//
+// Usage: tournament [-g GAMES] [-c CONCURRENT] [-o OPENINGS]
+//                   [-b BOOK] [-t TABLEBASE] [-m MAX_PLIES] AGENT AGENT
+//
+// AGENT is mcts:MS[:THREADS] or minimax:MS[:THREADS], the time per
+// move in milliseconds and the threads of each search, 1 by default.
+// CONCURRENT games are played at a time, by default as many as fit
+// on the cores. Each opening is played twice, once with each agent
+// as P1.
+//
+// OPENINGS has one opening per line, moves separated by spaces. A
+// move is its squares as row and column digits, as Board::print
+// numbers them, joined by '-' or 'x', e.g. "21-32 56-45". By default
+// the openings are every pair of first moves.
+//
+// A game is drawn once it reaches MAX_PLIES plies, 300 by default.
+// With a tablebase, a game ends with the tablebase value as soon as
+// few enough pieces are left.
+
+// Memory cap of the MCTS statistics kept between moves, per agent
+// and game.
+#define STORE_BYTES (size_t(64) << 20)
+
+namespace
+{
+  struct Agent
+  {
+    string name; // As given on the command line
+    bool mcts;
+    int time_ms;
+    int threads;
+  };
+
+  // Results and search statistics of one or more games, for the
+  // first agent.
+  struct Tally
+  {
+    Tally() : wins(0), losses(0), draws(0), plies(0)
+    {
+      for (int a = 0; a < 2; ++a) {
+	this->moves[a] = this->iterations[a] = this->depth[a] = 0;
+      }
+    }
+    unsigned long wins, losses, draws, plies;
+    // Searched moves of each agent, and the sums of their iterations
+    // and depths.
+    unsigned long moves[2], iterations[2], depth[2];
+    void add(const Tally &other)
+    {
+      this->wins += other.wins;
+      this->losses += other.losses;
+      this->draws += other.draws;
+      this->plies += other.plies;
+      for (int a = 0; a < 2; ++a) {
+	this->moves[a] += other.moves[a];
+	this->iterations[a] += other.iterations[a];
+	this->depth[a] += other.depth[a];
+      }
+    }
+  };
+
+  bool parse_agent(const string &arg, Agent &agent)
+  {
+    agent.name = arg;
+    agent.threads = 1;
+    size_t colon = arg.find(':');
+    string kind = arg.substr(0, colon);
+    if (colon == string::npos || (kind != "mcts" && kind != "minimax")) {
+      return false;
+    }
+    agent.mcts = kind == "mcts";
+    char *end;
+    agent.time_ms = strtol(arg.c_str() + colon + 1, &end, 10);
+    if (*end == ':') {
+      agent.threads = strtol(end + 1, &end, 10);
+    }
+    return !*end && agent.time_ms > 0 && agent.threads > 0;
+  }
+
+  // A move in opening notation, e.g. "21-32" or "52x34x16".
+  bool parse_move(const State &state, const string &text, Action &move)
+  {
+    vector<int> squares;
+    for (size_t i = 0; i < text.size(); i += 3) {
+      int row = text[i] - '0', col = i + 1 < text.size() ?
+	text[i + 1] - '0' : -1;
+      if (row < 0 || row >= BOARD_SIZE || col < 0 || col >= BOARD_SIZE ||
+	  (row + col) % 2 == 0 ||
+	  (i + 2 < text.size() && text[i + 2] != '-' && text[i + 2] != 'x')) {
+	return false;
+      }
+      squares.push_back(square_index(row, col));
+    }
+    ActionList actions;
+    state.board.legal_actions(state.get_cur_player(), actions);
+    for (auto it = actions.begin(); it != actions.end(); ++it) {
+      bool match = squares.size() >= 2 && it->from == squares[0] &&
+	it->to() == squares.back() &&
+	(squares.size() == 2 ||
+	 static_cast<int>(squares.size()) == it->length + 1);
+      for (size_t k = 1; match && k + 1 < squares.size(); ++k) {
+	match = it->path[k - 1] == squares[k];
+      }
+      if (match) {
+	move = *it;
+	return true;
+      }
+    }
+    return false;
+  }
+
+  bool read_openings(const string &path, vector<vector<Action>> &openings)
+  {
+    ifstream in(path);
+    if (!in) {
+      return false;
+    }
+    string line;
+    while (getline(in, line)) {
+      State state;
+      vector<Action> opening;
+      istringstream words(line);
+      string word;
+      while (words >> word) {
+	Action move;
+	if (!parse_move(state, word, move)) {
+	  cerr << "bad move " << word << " in opening: " << line << endl;
+	  return false;
+	}
+	opening.push_back(move);
+	state.apply_action(move);
+      }
+      if (!opening.empty()) {
+	openings.push_back(opening);
+      }
+    }
+    return !openings.empty();
+  }
+
+  vector<vector<Action>> default_openings()
+  {
+    vector<vector<Action>> openings;
+    State start;
+    auto firsts = start.board.legal_actions(start.get_cur_player());
+    for (auto &first : firsts) {
+      State s(start);
+      s.apply_action(first);
+      for (auto &reply : s.board.legal_actions(s.get_cur_player())) {
+	openings.push_back(vector<Action>{first, reply});
+      }
+    }
+    return openings;
+  }
+
+  // Plays one game from opening, with agents[0] as P1 unless swapped.
+  // Every agent searches with contexts of its own, so games can be
+  // played at the same time.
+  Tally play_game(const Agent agents[2], const vector<Action> &opening,
+		  bool swapped, const Book *book, const Tablebase *tablebase,
+		  int max_plies)
+  {
+    MCTS::Context mcts_contexts[2];
+    unique_ptr<MinimaxContext> minimax_contexts[2];
+    MCTS::Options mcts_options[2];
+    MinimaxOptions minimax_options[2];
+    for (int a = 0; a < 2; ++a) {
+      mcts_options[a].num_threads = agents[a].threads;
+      mcts_options[a].store_bytes = STORE_BYTES;
+      mcts_options[a].book = book;
+      mcts_options[a].tablebase = tablebase;
+      mcts_options[a].context = &mcts_contexts[a];
+      if (!agents[a].mcts) {
+	minimax_contexts[a].reset(new MinimaxContext());
+      }
+      minimax_options[a].num_threads = agents[a].threads;
+      minimax_options[a].book = book;
+      minimax_options[a].tablebase = tablebase;
+      minimax_options[a].context = minimax_contexts[a].get();
+    }
+
+    Tally tally;
+    State s;
+    for (auto &move : opening) {
+      s.apply_action(move);
+    }
+    int plies = opening.size();
+    // The outcome for the player to move when the game ends.
+    Outcome outcome = draw;
+    for (; plies < max_plies; ++plies) {
+      TBValue value;
+      if (tablebase && tablebase->probe(s, value)) {
+	outcome = value.outcome;
+	break;
+      }
+      auto actions = s.board.legal_actions(s.get_cur_player());
+      if (actions.empty()) {
+	outcome = loss;
+	break;
+      }
+      if (actions.size() == 1) {
+	s.apply_action(actions[0]);
+	continue;
+      }
+      int a = (s.get_cur_player() == P1) == swapped;
+      SearchStats stats;
+      Action action = agents[a].mcts ?
+	MCTS::UCTSearch(s, agents[a].time_ms, mcts_options[a], &stats) :
+	ABS_deepening(s, agents[a].time_ms, minimax_options[a],
+		      &stats).first;
+      ++tally.moves[a];
+      tally.iterations[a] += stats.iterations;
+      tally.depth[a] += stats.depth;
+      s.apply_action(action);
+    }
+    tally.plies = plies;
+    bool first_to_move = (s.get_cur_player() == P1) != swapped;
+    if (outcome == draw) {
+      tally.draws = 1;
+    }
+    else if ((outcome == win) == first_to_move) {
+      tally.wins = 1;
+    }
+    else {
+      tally.losses = 1;
+    }
+    return tally;
+  }
+
+  double elo(double score)
+  {
+    score = min(max(score, 1e-6), 1.0 - 1e-6);
+    // In this form an even score gives 0 rather than -0.
+    return 400.0 * log10(score / (1.0 - score));
+  }
+
+  void report(const Agent agents[2], const Tally &tally)
+  {
+    unsigned long games = tally.wins + tally.losses + tally.draws;
+    double score = (tally.wins + 0.5 * tally.draws) / games;
+    // Standard error of the mean score per game, widened to a 95%
+    // confidence interval.
+    double variance = (tally.wins * (1.0 - score) * (1.0 - score) +
+		       tally.draws * (0.5 - score) * (0.5 - score) +
+		       tally.losses * score * score) / games;
+    double margin = 1.96 * sqrt(variance / games);
+    cout << agents[0].name << " vs " << agents[1].name << ": " <<
+      tally.wins << " wins, " << tally.losses << " losses, " <<
+      tally.draws << " draws in " << games << " games" << endl;
+    cout << fixed << setprecision(3) << "score " << score << setprecision(1) <<
+      ", elo " << showpos << elo(score) << noshowpos << " +/- " <<
+      (elo(score + margin) - elo(score - margin)) / 2 << " (95%)" << endl;
+    cout << "average game length " << double(tally.plies) / games <<
+      " plies" << endl;
+    for (int a = 0; a < 2; ++a) {
+      unsigned long moves = max(tally.moves[a], 1ul);
+      cout << agents[a].name << ": " << tally.moves[a] <<
+	" moves searched, " << double(tally.iterations[a]) / moves <<
+	" iterations and depth " << double(tally.depth[a]) / moves <<
+	" per move" << endl;
+    }
+  }
+
+  void usage(const char *program)
+  {
+    cerr << "usage: " << program << " [-g GAMES] [-c CONCURRENT] " <<
+      "[-o OPENINGS] [-b BOOK] [-t TABLEBASE] [-m MAX_PLIES] AGENT AGENT" <<
+      endl << "AGENT is mcts:MS[:THREADS] or minimax:MS[:THREADS]" << endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int games = 0, concurrent = 0, max_plies = 300;
+  vector<vector<Action>> openings;
+  Book book;
+  Tablebase tablebase;
+  vector<Agent> agents;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "-g") && has_value) {
+      games = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-c") && has_value) {
+      concurrent = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-m") && has_value) {
+      max_plies = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-o") && has_value) {
+      if (!read_openings(argv[++i], openings)) {
+	cerr << "can't read openings " << argv[i] << endl;
+	return 1;
+      }
+    }
+    else if (!strcmp(argv[i], "-b") && has_value) {
+      if (!book.open(argv[++i])) {
+	cerr << "can't read book " << argv[i] << endl;
+	return 1;
+      }
+    }
+    else if (!strcmp(argv[i], "-t") && has_value) {
+      if (!tablebase.open(argv[++i])) {
+	cerr << "can't read tablebase " << argv[i] << endl;
+	return 1;
+      }
+    }
+    else {
+      Agent agent;
+      if (!parse_agent(argv[i], agent)) {
+	usage(argv[0]);
+	return 1;
+      }
+      agents.push_back(agent);
+    }
+  }
+  if (agents.size() != 2 || games < 0 || concurrent < 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (openings.empty()) {
+    openings = default_openings();
+  }
+  if (!games) {
+    games = 2 * openings.size();
+  }
+  if (!concurrent) {
+    concurrent = max(1, omp_get_max_threads() /
+		     max(agents[0].threads, agents[1].threads));
+  }
+  const Book *book_ptr = book.is_open() ? &book : nullptr;
+  const Tablebase *tablebase_ptr =
+    tablebase.is_open() ? &tablebase : nullptr;
+
+  // Each game's searches run their own threads.
+  omp_set_max_active_levels(2);
+  Tally total;
+  int played = 0;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(concurrent)
+  for (int g = 0; g < games; ++g) {
+    int o = (g / 2) % openings.size();
+    bool swapped = g % 2;
+    Tally tally = play_game(agents.data(), openings[o], swapped, book_ptr,
+			    tablebase_ptr, max_plies);
+#pragma omp critical
+    {
+      total.add(tally);
+      ++played;
+      cout << "game " << g + 1 << " (opening " << o + 1 << ", " <<
+	agents[swapped].name << " as P1): " << agents[0].name << " " <<
+	(tally.wins ? "wins" : tally.losses ? "loses" : "draws") <<
+	" after " << tally.plies << " plies [" << played << "/" << games <<
+	": +" << total.wins << " -" << total.losses << " =" << total.draws <<
+	"]" << endl;
+    }
+  }
+  report(agents.data(), total);
+  return 0;
+}
@@ -1,43 +1,77 @@
-#include <limits>
+#include <algorithm>
+#include <type_traits>
 #include "tree.h"
 
 using namespace std;
 
 namespace checkers
 {
-  static int node_id_counter = 0;
+  static_assert(is_trivially_destructible<Node>::value,
+		"Nodes are freed by resetting their arena");
 
-  Node::Node(Node *parent, const State &state, const Action &action)
+  Node::Node()
+    : parent(nullptr), children(nullptr), action(Action::nil()),
+      total_reward(0.0), visit_count(0), next_child(0), num_children(0),
+      expansion(unexpanded), proof(unproven), proof_plies(0) {}
+
+  // Creates the children of the node, whose state is state. Returns
+  // false if another thread is doing it right now.
+  bool Node::expand(const State &state, Arena &arena)
+  {
+    Expansion expected = unexpanded;
+    if (!this->expansion.compare_exchange_strong(expected, expanding)) {
+      return expected == expanded;
+    }
+    ActionList actions;
+    state.board.legal_actions(state.get_cur_player(), actions);
+    Node *children = arena.make_array<Node>(actions.size);
+    for (int i = 0; i < actions.size; ++i) {
+      children[i].parent = this;
+      children[i].action = actions[i];
+    }
+    this->children = children;
+    this->num_children = actions.size;
+    // The player to move has lost.
+    if (!actions.size) {
+      this->proof = proven_win;
+    }
+    this->expansion = expanded;
+    return true;
+  }
+
+  double Node::avg_reward() const
   {
-    this->init(parent, state, action);
-    this->unvisited_actions =
-      state.board.legal_actions(state.get_cur_player());
+    return this->total_reward / this->visit_count;
   }
 
-  void Node::init(Node *parent, const State &state, const Action &action)
+  bool Node::is_expanded() const
   {
-    this->id = node_id_counter++;
-    this->parent = parent;
-    this->state = state;
-    this->action = action;
-    this->total_reward = 0.0;
-    this->avg_reward = numeric_limits<double>::max();
-    this->visit_count = 0;
+    return this->expansion == expanded;
   }
 
-  Node::~Node()
+  bool Node::terminal() const
   {
-    for (auto it = this->children.begin();
-	 it != this->children.end(); ++it) {
-      delete *it;
+    return this->is_expanded() && this->num_children == 0;
+  }
+
+  bool Node::fully_expanded() const
+  {
+    return this->next_child >= this->num_children;
+  }
+
+  unsigned int Node::num_visited() const
+  {
+    if (!this->is_expanded()) {
+      return 0;
     }
+    return min<unsigned int>(this->next_child, this->num_children);
   }
 
   int tree_size(const Node *tree)
   {
     int sum = 1;
-    for (auto it = tree->children.begin(); it != tree->children.end(); ++it) {
-      sum += tree_size(*it);
+    for (unsigned int i = 0; i < tree->num_visited(); ++i) {
+      sum += tree_size(&tree->children[i]);
     }
     return sum;
   }
@@ -45,12 +79,68 @@ namespace checkers
   int tree_depth(const Node *tree)
   {
     int max_depth = 0;
-    for (auto it = tree->children.begin(); it != tree->children.end(); ++it) {
-      int d = tree_depth(*it);
-      if (d > max_depth) {
-	max_depth = d;
-      }
+    for (unsigned int i = 0; i < tree->num_visited(); ++i) {
+      max_depth = max(max_depth, tree_depth(&tree->children[i]));
     }
     return 1 + max_depth;
   }
+
+  namespace
+  {
+    void clone_into(Arena &arena, Node *node, Node *parent, const Node *tree)
+    {
+      node->parent = parent;
+      node->action = tree->action;
+      node->total_reward = tree->total_reward.load();
+      node->visit_count = tree->visit_count.load();
+      node->proof_plies = tree->proof_plies.load();
+      node->proof = tree->proof.load();
+      if (!tree->is_expanded()) {
+	return;
+      }
+      node->num_children = tree->num_children;
+      node->children = arena.make_array<Node>(tree->num_children);
+      unsigned int n = tree->num_visited();
+      for (unsigned int i = 0; i < tree->num_children; ++i) {
+	if (i < n) {
+	  clone_into(arena, &node->children[i], node, &tree->children[i]);
+	}
+	else {
+	  node->children[i].parent = node;
+	  node->children[i].action = tree->children[i].action;
+	}
+      }
+      node->next_child = n;
+      node->expansion = Node::expanded;
+    }
+  }
+
+  Node* clone_tree(Arena &arena, Node *parent, const Node *tree)
+  {
+    Node *node = arena.make<Node>();
+    clone_into(arena, node, parent, tree);
+    return node;
+  }
+
+  Node* find_state(Node *tree, const State &tree_state, const State &state,
+		   int max_depth)
+  {
+    if (tree_state == state) {
+      return tree;
+    }
+    if (max_depth <= 0) {
+      return nullptr;
+    }
+    State s(tree_state);
+    for (unsigned int i = 0; i < tree->num_visited(); ++i) {
+      Node *child = &tree->children[i];
+      Undo undo = s.apply_action(child->action);
+      Node *found = find_state(child, s, state, max_depth - 1);
+      if (found) {
+	return found;
+      }
+      s.undo_action(child->action, undo);
+    }
+    return nullptr;
+  }
 }
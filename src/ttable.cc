@@ -0,0 +1,90 @@
+#include "ttable.h"
+
+using namespace std;
+
+namespace checkers
+{
+  namespace
+  {
+    const unsigned char GENERATION_MASK = 0x3F;
+
+    // 32 bits of move, 16 of score, 8 of depth, 2 of bound and 6 of
+    // generation.
+    inline uint64_t pack(uint32_t move, int score, int depth, Bound bound,
+			 unsigned char generation)
+    {
+      return uint64_t(move) |
+	uint64_t(static_cast<uint16_t>(score)) << 32 |
+	uint64_t(static_cast<unsigned char>(depth)) << 48 |
+	uint64_t(bound) << 56 | uint64_t(generation) << 58;
+    }
+  }
+
+  TTable::TTable(size_t capacity)
+  {
+    size_t n = 1;
+    while (n < capacity) {
+      n <<= 1;
+    }
+    this->slots.reset(new Slot[n]);
+    this->size = n;
+    this->clear();
+  }
+
+  // Decodes a slot. Returns false if it is empty or torn.
+  bool TTable::read(const Slot &slot, TTEntry &entry) const
+  {
+    uint64_t data = slot.data.load(memory_order_relaxed);
+    entry.key = slot.check.load(memory_order_relaxed) ^ data;
+    entry.move = static_cast<uint32_t>(data);
+    entry.score = static_cast<int16_t>(data >> 32);
+    entry.depth = static_cast<signed char>(data >> 48);
+    entry.bound = static_cast<Bound>((data >> 56) & 3);
+    entry.generation = static_cast<unsigned char>(data >> 58);
+    return entry.key != 0;
+  }
+
+  bool TTable::probe(uint64_t key, TTEntry &entry) const
+  {
+    return this->read(this->slots[key & (this->size - 1)], entry) &&
+      entry.key == key;
+  }
+
+  void TTable::store(uint64_t key, int depth, Bound bound, int score,
+		     uint32_t move)
+  {
+    Slot &slot = this->slots[key & (this->size - 1)];
+    TTEntry e;
+    bool occupied = this->read(slot, e);
+    if (occupied && e.key != key && e.generation == this->generation &&
+	e.depth > depth) {
+      return;
+    }
+    // Keep the old best move if the new search didn't find one.
+    if (occupied && e.key == key && !move) {
+      move = e.move;
+    }
+    uint64_t data = pack(move, score, depth, bound, this->generation);
+    slot.data.store(data, memory_order_relaxed);
+    slot.check.store(key ^ data, memory_order_relaxed);
+  }
+
+  void TTable::new_search()
+  {
+    this->generation = (this->generation + 1) & GENERATION_MASK;
+  }
+
+  void TTable::clear()
+  {
+    for (size_t i = 0; i < this->size; ++i) {
+      this->slots[i].check.store(0, memory_order_relaxed);
+      this->slots[i].data.store(0, memory_order_relaxed);
+    }
+    this->generation = 0;
+  }
+
+  size_t TTable::capacity() const
+  {
+    return this->size;
+  }
+}
@@ -0,0 +1,18 @@
+#include "rng.h"
+#include "zobrist.h"
+
+namespace checkers
+{
+  ZobristKeys::ZobristKeys()
+  {
+    uint64_t seed = 0x636865636B657273ULL;
+    for (int kind = 0; kind < 4; ++kind) {
+      for (int s = 0; s < 32; ++s) {
+	this->piece[kind][s] = splitmix64(seed);
+      }
+    }
+    this->p2_to_move = splitmix64(seed);
+  }
+
+  const ZobristKeys zobrist;
+}